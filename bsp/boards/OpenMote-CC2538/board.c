@@ -17,6 +17,7 @@
 #include "gpio.h"
 #include "gptimer.h"
 #include "sys_ctrl.h"
+#include "sleepmode.h"
 #include "interrupt.h"
 #include "bsp_timer.h"
 #include "radiotimer.h"
@@ -38,6 +39,13 @@
 
 #define CC2538_FLASH_ADDRESS            ( 0x0027F800 )
 
+// PM2 exit, 32 MHz crystal start-up and radio timer restart, ~500 us
+#define BSP_SLEEP_WAKEUP_TICKS          ( 16 )
+// shortest sleep in PM1, sleep timer compares need 5 ticks
+#define BSP_SLEEP_MIN_TICKS             ( 8 )
+// shortest sleep in PM2, its longer wake-up must be worth it
+#define BSP_SLEEP_PM2_MIN_TICKS         ( 33 )
+
 //=========================== prototypes ======================================
 
 void antenna_init(void);
@@ -48,6 +56,15 @@ void board_timer_init(void);
 uint32_t board_timer_get(void);
 bool board_timer_expired(uint32_t future);
 
+// board-specific, for board_sleep()
+bool radio_isOff(void);
+bool uart_isIdle(void);
+PORT_RADIOTIMER_WIDTH radiotimer_getTicksToNextEvent(void);
+void radiotimer_suspend(void);
+void radiotimer_resume(PORT_RADIOTIMER_WIDTH elapsed);
+PORT_TIMER_WIDTH bsp_timer_setWakeup(PORT_TIMER_WIDTH wakeup);
+void bsp_timer_clearWakeup(void);
+
 
 static void clock_init(void);
 static void gpio_init(void);
@@ -92,10 +109,78 @@ void board_init(void) {
 
 /**
  * Puts the board to sleep
+ *
+ * When the radio is off and the UART idle, nothing needs the 32 MHz clock
+ * until the next event of the radio timer: the board enters PM1 or PM2, and
+ * the sleep timer wakes it up BSP_SLEEP_WAKEUP_TICKS before that event. The
+ * radio timer is stopped meanwhile, and restarted as if it had kept counting.
+ * Otherwise the CPU only waits for an interrupt, with the clocks running.
+ *
+ * opentimers runs on the sleep timer, which keeps counting in PM1/PM2, so
+ * opentimers_sleepTimeCompesation() is not needed.
  */
 void board_sleep(void) {
+    PORT_RADIOTIMER_WIDTH radioTicks;
+    uint32_t sleepTicks;
+    uint32_t stStopped;
+    uint32_t stNow;
+    uint32_t elapsed;
+
+    // interrupts still end the sleep, their handlers run once it is over
+    IntMasterDisable();
+
+    radioTicks = 0;
+    sleepTicks = 0;
+    if (radio_isOff() && uart_isIdle()) {
+        radioTicks = radiotimer_getTicksToNextEvent();
+    }
+    if (radioTicks >= BSP_SLEEP_WAKEUP_TICKS + BSP_SLEEP_MIN_TICKS) {
+        // an opentimers timer may wake the board up earlier
+        sleepTicks = bsp_timer_setWakeup(SleepModeTimerCountGet() + radioTicks - BSP_SLEEP_WAKEUP_TICKS);
+        if (sleepTicks < BSP_SLEEP_MIN_TICKS) {
+            bsp_timer_clearWakeup();
+        }
+    }
+    if (sleepTicks < BSP_SLEEP_MIN_TICKS) {
+        SysCtrlPowerModeSet(SYS_CTRL_PM_NOACTION);
+        SysCtrlSleep();
+        IntMasterEnable();
+        return;
+    }
+
+    radiotimer_suspend();
+    stStopped = SleepModeTimerCountGet();
+
+    // PM1/PM2 are entered from the 16 MHz RC oscillator
+    SysCtrlClockSet(true, true, SYS_CTRL_SYSDIV_16MHZ);
+    if (sleepTicks < BSP_SLEEP_PM2_MIN_TICKS) {
+        SysCtrlPowerModeSet(SYS_CTRL_PM_1);
+    } else {
+        SysCtrlPowerModeSet(SYS_CTRL_PM_2);
+    }
+    SysCtrlDeepSleep();
     SysCtrlPowerModeSet(SYS_CTRL_PM_NOACTION);
-    SysCtrlSleep();
+
+    // back on the 32 MHz crystal, as set by clock_init()
+    SysCtrlClockSet(true, false, SYS_CTRL_SYSDIV_32MHZ);
+    while (!((HWREG(SYS_CTRL_CLOCK_STA)) & (SYS_CTRL_CLOCK_STA_XOSC_STB)));
+
+    // wait for an edge of the 32 kHz clock: the sleep timer is up to date
+    // after PM2, and the radio timer restarts on the next edge
+    stNow = SleepModeTimerCountGet();
+    while (SleepModeTimerCountGet() == stNow);
+    stNow = SleepModeTimerCountGet();
+
+    elapsed = stNow + 1 - stStopped;
+    if (elapsed + 2 > radioTicks) {
+        // woke up late, have the event fire right away rather than be missed;
+        // the timer may have counted one more tick before it stopped
+        elapsed = radioTicks - 2;
+    }
+    radiotimer_resume(elapsed);
+
+    bsp_timer_clearWakeup();
+    IntMasterEnable();
 }
 
 /**
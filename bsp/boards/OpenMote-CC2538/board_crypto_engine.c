@@ -0,0 +1,124 @@
+/**
+ * Description: CC2538-specific definition of the "cryptoengine" driver, on
+ *              the AES/CCM coprocessor.
+ */
+
+#include <string.h>
+
+#include "sys_ctrl.h"
+#include "aes.h"
+#include "ccm.h"
+
+#include "cryptoengine.h"
+
+//=========================== defines =========================================
+
+#define BOARD_CRYPTO_ENGINE_KEY_AREA    ( KEY_AREA_0 )
+#define BOARD_CRYPTO_ENGINE_CCM_L       ( 2 )
+
+//=========================== variables =======================================
+
+typedef struct {
+   uint8_t    key[CRYPTOENGINE_AES_BLOCK_LENGTH]; // kept to reload the key store, which PM2 does not retain
+} board_crypto_engine_vars_t;
+
+board_crypto_engine_vars_t board_crypto_engine_vars;
+
+//=========================== prototypes ======================================
+
+owerror_t board_crypto_engine_init(uint8_t* key);
+owerror_t board_crypto_engine_aes_ccms_mic(
+   uint8_t*    a,
+   uint8_t     len_a,
+   uint8_t*    nonce,
+   uint8_t*    mic,
+   uint8_t     micLength
+);
+uint8_t   board_crypto_engine_ccmStart(uint8_t* a, uint8_t len_a, uint8_t* nonce, uint8_t micLength);
+
+const crypto_engine_t board_crypto_engine = {
+   board_crypto_engine_init,
+   board_crypto_engine_aes_ccms_mic,
+};
+
+//=========================== public ==========================================
+
+/**
+\brief Power the AES coprocessor and write the key to its key store.
+
+The coprocessor reads the key from the key store for every frame, so nothing
+is expanded in software.
+*/
+owerror_t board_crypto_engine_init(uint8_t* key) {
+   memcpy(board_crypto_engine_vars.key,key,CRYPTOENGINE_AES_BLOCK_LENGTH);
+
+   // board_init() gates the AES clock, this is its only user
+   SysCtrlPeripheralEnable(SYS_CTRL_PERIPH_AES);
+
+   if (AESLoadKey(board_crypto_engine_vars.key,BOARD_CRYPTO_ENGINE_KEY_AREA)!=AES_SUCCESS) {
+      return E_FAIL;
+   }
+   return E_SUCCESS;
+}
+
+/**
+\brief CCM* authentication tag of a, without encryption.
+
+The coprocessor DMAs a in and computes the tag in a few microseconds. This
+polls for the result, as the MAC needs it before loading the frame into the
+radio.
+*/
+owerror_t board_crypto_engine_aes_ccms_mic(
+      uint8_t*    a,
+      uint8_t     len_a,
+      uint8_t*    nonce,
+      uint8_t*    mic,
+      uint8_t     micLength
+   ) {
+   uint8_t cstate[CRYPTOENGINE_MAX_MIC_LENGTH];
+   uint8_t result;
+
+   if (micLength>CRYPTOENGINE_MAX_MIC_LENGTH) {
+      return E_FAIL;
+   }
+
+   result = board_crypto_engine_ccmStart(a,len_a,nonce,micLength);
+   if (result==AES_KEYSTORE_READ_ERROR) {
+      // the key store was lost in PM2, reload it once
+      if (AESLoadKey(board_crypto_engine_vars.key,BOARD_CRYPTO_ENGINE_KEY_AREA)!=AES_SUCCESS) {
+         return E_FAIL;
+      }
+      result = board_crypto_engine_ccmStart(a,len_a,nonce,micLength);
+   }
+   if (result!=AES_SUCCESS) {
+      return E_FAIL;
+   }
+
+   while (CCMAuthEncryptCheckResult()==0);
+
+   if (CCMAuthEncryptGetResult(micLength,0,cstate)!=AES_SUCCESS) {
+      return E_FAIL;
+   }
+   memcpy(mic,cstate,micLength);
+   return E_SUCCESS;
+}
+
+//=========================== private =========================================
+
+uint8_t board_crypto_engine_ccmStart(uint8_t* a, uint8_t len_a, uint8_t* nonce, uint8_t micLength) {
+   uint8_t cstate[CRYPTOENGINE_MAX_MIC_LENGTH];
+
+   return CCMAuthEncryptStart(
+      false,                          // authentication only, no payload to encrypt
+      micLength,
+      nonce,
+      NULL,
+      0,
+      a,
+      len_a,
+      BOARD_CRYPTO_ENGINE_KEY_AREA,
+      cstate,
+      BOARD_CRYPTO_ENGINE_CCM_L,
+      0                               // poll, no interrupt
+   );
+}
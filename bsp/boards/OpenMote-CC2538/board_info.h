@@ -75,6 +75,35 @@
 
 #define SYNC_ACCURACY                       1     // ticks
 
+//===== uart
+
+// the UART can transmit a buffer through the uDMA, see uart_writeBuffer()
+#define BOARD_UART_DMA_TX
+
+//===== nvm
+
+// 8 pages of flash are reserved for the flash log, see nvm.h
+#define BOARD_NVM
+#define NVM_NUMPAGES                        8
+#define NVM_PAGE_SIZE                       2048
+#define NVM_ERASE_TICKS                     656   // 20ms page erase
+#define NVM_WORDS_PER_1024_TICKS            1024  // 30us per word, 20us typical
+
+//===== energy
+
+// currents drawn, in uA, for the energy meter; the radio's add to the CPU's
+#define BOARD_CURRENT_CPU_UA                13000 // active mode, 32MHz
+#define BOARD_CURRENT_SLEEP_UA              1     // PM2, 1.3uA
+#define BOARD_CURRENT_RX_UA                 20000
+// by l1_txPower>>2, from -24dBm to +3dBm, see radio_setTxPower()
+#define BOARD_CURRENT_TX_UA                 {17000,18000,19000,20000,22000,24000,25000,28000}
+
+//===== security
+
+// the AES coprocessor authenticates an EB within maxTxDataPrepare, see
+// L2_SECURITY_ACTIVE
+#define BOARD_L2_SECURITY
+
 //===== per-board number of sensors
 
 #define NUMSENSORS 7
@@ -27,6 +27,8 @@ typedef struct {
 	bool initiated;
 	uint32_t tooclose;
 	uint32_t diff;
+	bool scheduled;   // is a compare event coming?
+	bool wakeupSet;   // has board_sleep() replaced the compare value?
 } bsp_timer_vars_t;
 
 bsp_timer_vars_t bsp_timer_vars;
@@ -66,9 +68,13 @@ void bsp_timer_set_callback(bsp_timer_cbt cb) {
  counter, and cancels a possible pending compare event.
  */
 void bsp_timer_reset() {
-	// reset compare
+	// reset compare, including one which already happened but was not handled
+	IntDisable(INT_SMTIM);
+	IntPendClear(INT_SMTIM);
+	bsp_timer_vars.scheduled = false;
 
-	// reset timer
+	// reset timer, the sleep timer can not be written: the next compare is
+	// relative to the value of the counter when it is scheduled
     bsp_timer_vars.initiated=false;
 	// record last timer compare value
 	bsp_timer_vars.last_compare_value = 0;
@@ -120,6 +126,7 @@ void bsp_timer_scheduleIn(PORT_TIMER_WIDTH delayTicks) {
 		// this is the normal case, have timer expire at newCompareValue
 		SleepModeTimerCompareSet(newCompareValue);
 	}
+	bsp_timer_vars.scheduled = true;
 	//enable interrupt
 	IntEnable(INT_SMTIM);
 }
@@ -128,8 +135,10 @@ void bsp_timer_scheduleIn(PORT_TIMER_WIDTH delayTicks) {
  \brief Cancel a running compare.
  */
 void bsp_timer_cancel_schedule() {
-	// Disable the Timer0B interrupt.
+	// Disable the Timer0B interrupt, and drop a compare which already happened
 	IntDisable(INT_SMTIM);
+	IntPendClear(INT_SMTIM);
+	bsp_timer_vars.scheduled = false;
 }
 
 /**
@@ -141,11 +150,65 @@ PORT_TIMER_WIDTH bsp_timer_get_currentValue() {
 	return SleepModeTimerCountGet();
 }
 
+/**
+ \brief Have the sleep timer wake the board up from PM1/PM2 at wakeup, at the
+ latest.
+
+ The sleep timer has a single compare register. If the next compare event is
+ before wakeup, it is kept. Otherwise wakeup replaces it, until
+ bsp_timer_clearWakeup(). Board-specific, for board_sleep().
+
+ \param wakeup Value of the counter to wake up at, at least 5 ticks from now.
+
+ \returns The number of ticks from now until the board wakes up.
+ */
+PORT_TIMER_WIDTH bsp_timer_setWakeup(PORT_TIMER_WIDTH wakeup) {
+	PORT_TIMER_WIDTH current;
+	int32_t toCompare;
+
+	current = SleepModeTimerCountGet();
+	if (bsp_timer_vars.scheduled) {
+		toCompare = (int32_t)(bsp_timer_vars.last_compare_value - current);
+		if (toCompare <= (int32_t)(wakeup - current)) {
+			return toCompare > 0 ? toCompare : 0;
+		}
+	}
+
+	SleepModeTimerCompareSet(wakeup);
+	bsp_timer_vars.wakeupSet = true;
+	IntEnable(INT_SMTIM);
+	return wakeup - current;
+}
+
+/**
+ \brief Undo bsp_timer_setWakeup(), once awake.
+
+ The compare event of the wake-up, if it happened, is not passed on to
+ bsp_timer_isr().
+ */
+void bsp_timer_clearWakeup() {
+	if (!bsp_timer_vars.wakeupSet) {
+		return;
+	}
+	bsp_timer_vars.wakeupSet = false;
+
+	IntPendClear(INT_SMTIM);
+	if (!bsp_timer_vars.scheduled) {
+		IntDisable(INT_SMTIM);
+	} else if ((int32_t)(bsp_timer_vars.last_compare_value - SleepModeTimerCountGet()) < 5) {
+		// too close to be set, see SleepModeTimerCompareSet()
+		IntPendSet(INT_SMTIM);
+	} else {
+		SleepModeTimerCompareSet(bsp_timer_vars.last_compare_value);
+	}
+}
+
 //=========================== private =========================================
 
 void bsp_timer_isr_private(void) {
 	debugpins_isr_set();
 	IntPendClear(INT_SMTIM);
+	bsp_timer_vars.scheduled = false;
 	bsp_timer_isr();
 	debugpins_isr_clr();
 }
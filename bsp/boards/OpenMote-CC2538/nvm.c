@@ -0,0 +1,39 @@
+/**
+ * Description: CC2538-specific definition of the "nvm" bsp module.
+ */
+
+#include <headers/hw_memmap.h>
+
+#include "string.h"
+#include "nvm.h"
+#include "flash.h"
+
+//=========================== defines =========================================
+
+// the pages right below the CCA page, see FLASH_NVM in cc2538.lds
+#define BSP_NVM_ADDRESS         ( 0x0027F800 - NVM_NUMPAGES*NVM_PAGE_SIZE )
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+//=========================== public ==========================================
+
+void nvm_erasePage(uint8_t page) {
+   FlashMainPageErase(BSP_NVM_ADDRESS+(uint32_t)page*NVM_PAGE_SIZE);
+}
+
+void nvm_programWords(uint8_t page, uint16_t offset, uint32_t* words, uint16_t numWords) {
+   FlashMainPageProgram(
+      words,
+      BSP_NVM_ADDRESS+(uint32_t)page*NVM_PAGE_SIZE+offset,
+      (uint32_t)numWords*sizeof(uint32_t)
+   );
+}
+
+void nvm_read(uint8_t page, uint16_t offset, uint8_t* buffer, uint16_t length) {
+   // the flash is memory-mapped
+   memcpy(buffer,(uint8_t*)(BSP_NVM_ADDRESS+(uint32_t)page*NVM_PAGE_SIZE+offset),length);
+}
+
+//=========================== private =========================================
@@ -34,6 +34,11 @@
 #define RSSI_OFFSET 73
 #define CHECKSUM_LEN 2
 
+/* TXPOWER values by power level>>2, -24, -15, -11, -7, -3, 0, +1 and +3dBm */
+static const uint8_t radio_txPowerTable[(RADIO_TXPOWER_MAX>>2)+1] = {
+   0x00, 0x42, 0x62, 0x88, 0xa1, 0xb6, 0xc5, CC2538_RF_TX_POWER_RECOMMENDED
+};
+
 //=========================== variables =======================================
 
 typedef struct {
@@ -230,6 +235,19 @@ void radio_setFrequency(uint8_t frequency) {
    radio_vars.state = RADIOSTATE_FREQUENCY_SET;
 }
 
+/**
+\brief Set the TX power of the next frames.
+
+\param[in] power The power level, 0 to RADIO_TXPOWER_MAX. The maximum is the
+   recommended +3dBm the radio starts with.
+*/
+void radio_setTxPower(uint8_t power) {
+   if (power>RADIO_TXPOWER_MAX) {
+      power = RADIO_TXPOWER_MAX;
+   }
+   HWREG(RFCORE_XREG_TXPOWER) = radio_txPowerTable[power>>2];
+}
+
 void radio_rfOn() {
    //radio_on();
 }
@@ -249,6 +267,15 @@ void radio_rfOff() {
    radio_vars.state = RADIOSTATE_RFOFF;
 }
 
+/**
+\brief Whether the radio is off, so it loses nothing in PM1/PM2.
+
+Board-specific, for board_sleep().
+*/
+bool radio_isOff() {
+   return radio_vars.state==RADIOSTATE_RFOFF;
+}
+
 //===== TX
 
 void radio_loadPacket(uint8_t* packet, uint8_t len) {
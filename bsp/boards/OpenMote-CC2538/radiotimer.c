@@ -200,6 +200,82 @@ port_INLINE PORT_RADIOTIMER_WIDTH radiotimer_getCapturedTime() {
      return value;
 }
 
+//===== sleep
+
+/**
+\brief Number of ticks until the next compare or overflow event, 0 if one is
+pending or the timer is not running.
+
+Board-specific, for board_sleep().
+*/
+PORT_RADIOTIMER_WIDTH radiotimer_getTicksToNextEvent() {
+   PORT_RADIOTIMER_WIDTH now;
+   PORT_RADIOTIMER_WIDTH next;
+   PORT_RADIOTIMER_WIDTH compare;
+   uint8_t               irqm;
+
+   irqm = HWREG(RFCORE_SFR_MTIRQM);
+   if ((HWREG(RFCORE_SFR_MTCTRL) & RFCORE_SFR_MTCTRL_STATE)==0 || (HWREG(RFCORE_SFR_MTIRQF) & irqm)) {
+      return 0;
+   }
+
+   now  = radiotimer_getValue();
+   next = radiotimer_getPeriod();
+   if (irqm & RFCORE_SFR_MTIRQM_MACTIMER_OVF_COMPARE1M) {
+      //select ovf cmp1 register in the selector so it can be read
+      HWREG(RFCORE_SFR_MTMSEL) = (0x03 << RFCORE_SFR_MTMSEL_MTMOVFSEL_S) & RFCORE_SFR_MTMSEL_MTMOVFSEL_M;
+      compare  = HWREG(RFCORE_SFR_MTMOVF0);
+      compare += (HWREG(RFCORE_SFR_MTMOVF1)<<8);
+      compare += (HWREG(RFCORE_SFR_MTMOVF2)<<16);
+      if (compare<next) {
+         next = compare;
+      }
+   }
+   if (next<=now) {
+      return 0;
+   }
+   return next-now;
+}
+
+/**
+\brief Stop the timer, on an edge of the 32kHz clock, before PM1/PM2 stops its
+32MHz clock.
+
+Board-specific, for board_sleep().
+*/
+void radiotimer_suspend() {
+   HWREG(RFCORE_SFR_MTCTRL) &= ~RFCORE_SFR_MTCTRL_RUN;
+   while (HWREG(RFCORE_SFR_MTCTRL) & RFCORE_SFR_MTCTRL_STATE);
+}
+
+/**
+\brief Restart the timer as if it had kept counting while suspended.
+
+It starts on the next edge of the 32kHz clock, as when started.
+Board-specific, for board_sleep().
+
+\param elapsed Number of 32kHz ticks from when it stopped to when it starts.
+*/
+void radiotimer_resume(PORT_RADIOTIMER_WIDTH elapsed) {
+   PORT_RADIOTIMER_WIDTH value;
+
+   value = radiotimer_getValue()+elapsed;
+
+   //set counter on the timer to 0 tics, the next tic starts with the timer
+   HWREG(RFCORE_SFR_MTMSEL) = (0x00 << RFCORE_SFR_MTMSEL_MTMSEL_S) & RFCORE_SFR_MTMSEL_MTMSEL_M;
+   HWREG(RFCORE_SFR_MTM0)=(0x00<< RFCORE_SFR_MTM0_MTM0_S) & RFCORE_SFR_MTM0_MTM0_M;
+   HWREG(RFCORE_SFR_MTM1)=(0x00<< RFCORE_SFR_MTM1_MTM1_S) & RFCORE_SFR_MTM1_MTM1_M;
+
+   //select counter register in the selector so it can be modified
+   HWREG(RFCORE_SFR_MTMSEL) = (0x00<< RFCORE_SFR_MTMSEL_MTMOVFSEL_S) & RFCORE_SFR_MTMSEL_MTMOVFSEL_M;
+   HWREG(RFCORE_SFR_MTMOVF0) = (value << RFCORE_SFR_MTMOVF0_MTMOVF0_S) & RFCORE_SFR_MTMOVF0_MTMOVF0_M;
+   HWREG(RFCORE_SFR_MTMOVF1) = ((value >> 8) << RFCORE_SFR_MTMOVF1_MTMOVF1_S) & RFCORE_SFR_MTMOVF1_MTMOVF1_M;
+   HWREG(RFCORE_SFR_MTMOVF2) = ((value >> 16) << RFCORE_SFR_MTMOVF2_MTMOVF2_S) & RFCORE_SFR_MTMOVF2_MTMOVF2_M;
+
+   HWREG(RFCORE_SFR_MTCTRL) |= RFCORE_SFR_MTCTRL_RUN;
+   while (!(HWREG(RFCORE_SFR_MTCTRL) & RFCORE_SFR_MTCTRL_STATE));
+}
+
 //=========================== private =========================================
 
 port_INLINE uint16_t get_real_counter(void){
@@ -9,6 +9,7 @@
 #include <headers/hw_ioc.h>
 #include <headers/hw_memmap.h>
 #include <headers/hw_types.h>
+#include <headers/hw_uart.h>
 
 #include "stdint.h"
 #include "stdio.h"
@@ -21,12 +22,15 @@
 #include "board.h"
 #include "ioc.h"
 #include "debugpins.h"
+#include "udma.h"
 
 //=========================== defines =========================================
 
 #define PIN_UART_RXD            GPIO_PIN_0 // PA0 is UART RX
 #define PIN_UART_TXD            GPIO_PIN_1 // PA1 is UART TX
 
+#define UART_DMA_TX_CHANNEL     UDMA_CH9_UART0TX
+
 //=========================== variables =======================================
 
 typedef struct {
@@ -36,6 +40,15 @@ typedef struct {
 
 uart_vars_t uart_vars;
 
+// uDMA channel control table, only the primary structures are used. The
+// hardware requires the table to be aligned on 1024 bytes.
+#if defined(__IAR_SYSTEMS_ICC__)
+#pragma data_alignment=1024
+static tDMAControlTable uart_dmaControlTable[32];
+#else
+static tDMAControlTable uart_dmaControlTable[32] __attribute__ ((aligned(1024)));
+#endif
+
 //=========================== prototypes ======================================
 
 static void uart_isr_private(void);
@@ -79,6 +92,15 @@ void uart_init() {
    // Raise interrupt at end of tx (not by fifo)
    UARTTxIntModeSet(UART0_BASE, UART_TXINT_MODE_EOT);
 
+   // Let the uDMA feed the transmitter, one byte per request
+   uDMAEnable();
+   uDMAControlBaseSet(uart_dmaControlTable);
+   uDMAChannelAssign(UART_DMA_TX_CHANNEL);
+   uDMAChannelAttributeDisable(UART_DMA_TX_CHANNEL, UDMA_ATTR_ALL);
+   uDMAChannelControlSet(UART_DMA_TX_CHANNEL | UDMA_PRI_SELECT,
+                         UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_1);
+   UARTDMAEnable(UART0_BASE, UART_DMA_TX);
+
    // Register isr in the nvic and enable isr at the nvic
    UARTIntRegister(UART0_BASE, uart_isr_private);
 
@@ -111,6 +133,47 @@ void  uart_writeByte(uint8_t byteToWrite){
 	UARTCharPut(UART0_BASE, byteToWrite);
 }
 
+/**
+\brief Transmit a buffer through the uDMA.
+
+The TX interrupt fires once, when the last byte has left the UART, rather than
+once per byte. The buffer must stay untouched until then.
+
+\param[in] buffer The bytes to send, in RAM.
+\param[in] length Number of bytes to send, at most 1024.
+*/
+void uart_writeBuffer(uint8_t* buffer, uint16_t length) {
+   uDMAChannelTransferSet(UART_DMA_TX_CHANNEL | UDMA_PRI_SELECT,
+                          UDMA_MODE_BASIC,
+                          buffer,
+                          (void*)(UART0_BASE + UART_O_DR),
+                          length);
+   uDMAChannelEnable(UART_DMA_TX_CHANNEL);
+}
+
+/**
+\brief Whether the uDMA is still busy with the buffer of uart_writeBuffer().
+*/
+bool uart_isWritingBuffer() {
+   return uDMAChannelIsEnabled(UART_DMA_TX_CHANNEL);
+}
+
+/**
+\brief Whether the UART is idle, so it loses nothing in PM1/PM2.
+
+Its interrupts are only enabled while openserial sends or listens.
+Board-specific, for board_sleep().
+*/
+bool uart_isIdle() {
+   if (HWREG(UART0_BASE + UART_O_IM) & (UART_INT_RX | UART_INT_RT | UART_INT_TX)) {
+      return false;
+   }
+   if (uDMAChannelIsEnabled(UART_DMA_TX_CHANNEL) || UARTBusy(UART0_BASE)) {
+      return false;
+   }
+   return true;
+}
+
 uint8_t uart_readByte(){
 	 int32_t i32Char;
      i32Char = UARTCharGet(UART0_BASE);
@@ -144,6 +207,10 @@ static void uart_isr_private(void){
 
 kick_scheduler_t uart_tx_isr() {
    uart_clearTxInterrupts(); // TODO: do not clear, but disable when done
+   if (uDMAChannelIsEnabled(UART_DMA_TX_CHANNEL)) {
+      // the transmitter ran dry in the middle of a buffer, wait for its end
+      return DO_NOT_KICK_SCHEDULER;
+   }
    if (uart_vars.txCb != NULL) {
        uart_vars.txCb();
    }
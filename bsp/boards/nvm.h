@@ -0,0 +1,45 @@
+#ifndef __NVM_H
+#define __NVM_H
+
+/**
+\addtogroup BSP
+\{
+\addtogroup nvm
+\{
+
+\brief Cross-platform declaration "nvm" bsp module.
+
+A region of the internal flash reserved for the firmware's own records, made of
+NVM_NUMPAGES pages of NVM_PAGE_SIZE bytes. Pages are numbered from 0, offsets
+are in bytes from the start of the page. Only boards which define BOARD_NVM in
+their board_info.h implement it.
+
+Erasing and programming stall the CPU until they complete, the caller picks a
+time when nothing else needs it. NVM_ERASE_TICKS is the duration of a page
+erase and NVM_WORDS_PER_1024_TICKS the number of words programmed per 1024
+ticks of the 32kHz timer.
+*/
+
+#include "stdint.h"
+#include "board.h"
+
+//=========================== define ==========================================
+
+//=========================== typedef =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+#ifdef BOARD_NVM
+void    nvm_erasePage(uint8_t page);
+void    nvm_programWords(uint8_t page, uint16_t offset, uint32_t* words, uint16_t numWords);
+void    nvm_read(uint8_t page, uint16_t offset, uint8_t* buffer, uint16_t length);
+#endif
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -74,6 +74,19 @@
 
 #define SYNC_ACCURACY                       1 // when using openmoteSTM, change to 2
 
+//===== energy
+
+// currents drawn, in uA, for the energy meter, those of the CC2538
+#define BOARD_CURRENT_CPU_UA                13000
+#define BOARD_CURRENT_SLEEP_UA              1
+#define BOARD_CURRENT_RX_UA                 20000
+#define BOARD_CURRENT_TX_UA                 {17000,18000,19000,20000,22000,24000,25000,28000}
+
+//===== security
+
+// the TX prepare is not timed in simulation, the firmware AES fits it
+#define BOARD_L2_SECURITY
+
 //=========================== typedef  ========================================
 
 //=========================== variables =======================================
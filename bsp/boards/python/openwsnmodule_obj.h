@@ -148,6 +148,8 @@ enum {
    MOTE_NOTIF_uart_writeCircularBuffer_FASTSIM,
    MOTE_NOTIF_uart_writeBufferByLen_FASTSIM,
    MOTE_NOTIF_uart_readByte,
+   // added later, appended so the simulator's indices above do not change
+   MOTE_NOTIF_radio_setTxPower,
    // last
    MOTE_NOTIF_LAST
 };
@@ -245,6 +245,35 @@ void radio_setFrequency(OpenMote* self, uint8_t frequency) {
 #endif
 }
 
+void radio_setTxPower(OpenMote* self, uint8_t power) {
+   PyObject*   result;
+   PyObject*   arglist;
+   
+#ifdef TRACE_ON
+   printf("C@0x%x: radio_setTxPower(power=%d)... \n",self,power);
+#endif
+   
+   // a simulator which does not model the TX power does not register it
+   if (self->callback[MOTE_NOTIF_radio_setTxPower] == NULL) {
+      return;
+   }
+   
+   // forward to Python, the radio medium computes the link budget with it
+   arglist    = Py_BuildValue("(i)",power);
+   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_setTxPower],arglist);
+   if (result == NULL) {
+      printf("[CRITICAL] radio_setTxPower() returned NULL\r\n");
+      Py_DECREF(arglist);
+      return;
+   }
+   Py_DECREF(result);
+   Py_DECREF(arglist);
+   
+#ifdef TRACE_ON
+   printf("C@0x%x: ...done.\n",self);
+#endif
+}
+
 void radio_rfOn(OpenMote* self) {
    PyObject*   result;
    
@@ -18,6 +18,14 @@
 
 #define LENGTH_CRC 2
 
+/**
+\brief Highest TX power level, see radio_setTxPower().
+
+Levels are on the scale of the PA_LEVEL of the CC2420, from 0 to 31. Each board
+rounds them down to the steps its radio has.
+*/
+#define RADIO_TXPOWER_MAX 31
+
 /**
 \brief Current state of the radio.
 
@@ -63,6 +71,7 @@ void     radio_setTimerPeriod(PORT_TIMER_WIDTH period);
 PORT_TIMER_WIDTH radio_getTimerPeriod(void);
 // RF admin
 void     radio_setFrequency(uint8_t frequency);
+void     radio_setTxPower(uint8_t power);
 void     radio_rfOn(void);
 void     radio_rfOff(void);
 // TX
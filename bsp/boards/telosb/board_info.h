@@ -72,6 +72,15 @@ to this board.
 
 #define SYNC_ACCURACY                       1     // ticks
 
+//===== energy
+
+// currents drawn, in uA, for the energy meter; the CC2420's add to the MSP430's
+#define BOARD_CURRENT_CPU_UA                1800  // MCU on, 4MHz
+#define BOARD_CURRENT_SLEEP_UA              5     // LPM3
+#define BOARD_CURRENT_RX_UA                 19700
+// by l1_txPower>>2, PA_LEVEL 3 (-25dBm) to 31 (0dBm)
+#define BOARD_CURRENT_TX_UA                 {8500,9900,11200,12500,13900,15200,16500,17400}
+
 //=========================== variables =======================================
 
 // The variables below are used by CoAP's registration engine.
@@ -112,7 +112,7 @@ void bsp_timer_scheduleIn(PORT_TIMER_WIDTH delayTicks) {
 */
 void bsp_timer_cancel_schedule() {
    TACCR0               =  0;
-   TACCTL0             &= ~CCIE;
+   TACCTL0             &= ~(CCIE|CCIFG);
 }
 
 /**
@@ -121,7 +121,7 @@ void bsp_timer_cancel_schedule() {
 \returns The current value of the timer's counter.
 */
 PORT_TIMER_WIDTH bsp_timer_get_currentValue() {
-   return TBR;
+   return TAR;
 }
 
 //=========================== private =========================================
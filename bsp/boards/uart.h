@@ -41,6 +41,10 @@ void    uart_writeByte(uint8_t byteToWrite);
 #ifdef FASTSIM
 void    uart_writeCircularBuffer_FASTSIM(uint8_t* buffer, uint8_t* outputBufIdxR, uint8_t* outputBufIdxW);
 #endif
+#ifdef BOARD_UART_DMA_TX
+void    uart_writeBuffer(uint8_t* buffer, uint16_t length);
+bool    uart_isWritingBuffer(void);
+#endif
 uint8_t uart_readByte(void);
 
 // interrupt handlers
@@ -18,6 +18,7 @@
 typedef struct {
    cc2420_status_t radioStatusByte;
    radio_state_t   state;
+   uint8_t         txPower;          // PA_LEVEL last written to TXCTRL
 } radio_vars_t;
 
 radio_vars_t radio_vars;
@@ -96,7 +97,8 @@ void radio_reset(void) {
    );
    
    // speed up time to TX
-   cc2420_TXCTRL_reg.PA_LEVEL               = 31;// max. TX power (~0dBm)
+   radio_vars.txPower                       = RADIO_TXPOWER_MAX;
+   cc2420_TXCTRL_reg.PA_LEVEL               = radio_vars.txPower;// max. TX power (~0dBm)
    cc2420_TXCTRL_reg.reserved_w1            = 1;
    cc2420_TXCTRL_reg.PA_CURRENT             = 3;
    cc2420_TXCTRL_reg.TXMIX_CURRENT          = 0;
@@ -173,6 +175,40 @@ void radio_setFrequency(uint8_t frequency) {
    radio_vars.state = RADIOSTATE_FREQUENCY_SET;
 }
 
+/**
+\brief Set the TX power of the next frames.
+
+The power level is the PA_LEVEL of the CC2420, 3 (-25dBm) to 31 (0dBm). TXCTRL
+is only written when it changes, it costs an SPI access in the TX prepare time.
+
+\param[in] power The power level, 0 to RADIO_TXPOWER_MAX.
+*/
+void radio_setTxPower(uint8_t power) {
+   cc2420_TXCTRL_reg_t cc2420_TXCTRL_reg;
+   
+   if (power>RADIO_TXPOWER_MAX) {
+      power = RADIO_TXPOWER_MAX;
+   }
+   if (power==radio_vars.txPower) {
+      return;
+   }
+   radio_vars.txPower                       = power;
+   
+   // same as in radio_reset(), but the PA_LEVEL
+   cc2420_TXCTRL_reg.PA_LEVEL               = power;
+   cc2420_TXCTRL_reg.reserved_w1            = 1;
+   cc2420_TXCTRL_reg.PA_CURRENT             = 3;
+   cc2420_TXCTRL_reg.TXMIX_CURRENT          = 0;
+   cc2420_TXCTRL_reg.TXMIX_CAP_ARRAY        = 0;
+   cc2420_TXCTRL_reg.TX_TURNAROUND          = 0;
+   cc2420_TXCTRL_reg.TXMIXBUF_CUR           = 2;
+   cc2420_spiWriteReg(
+      CC2420_TXCTRL_ADDR,
+      &radio_vars.radioStatusByte,
+      *(uint16_t*)&cc2420_TXCTRL_reg
+   );
+}
+
 void radio_rfOn(void) {   
    cc2420_spiStrobe(CC2420_SXOSCON, &radio_vars.radioStatusByte);
    while (radio_vars.radioStatusByte.xosc16m_stable==0) {
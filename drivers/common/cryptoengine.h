@@ -0,0 +1,63 @@
+/**
+\brief Declaration of the "cryptoengine" driver.
+*/
+
+#ifndef __CRYPTOENGINE_H
+#define __CRYPTOENGINE_H
+
+#include "opendefs.h"
+
+/**
+\addtogroup drivers
+\{
+\addtogroup Cryptoengine
+\{
+*/
+
+//=========================== define ==========================================
+
+/// Length of an AES-128 key and block, in bytes.
+#define CRYPTOENGINE_AES_BLOCK_LENGTH 16
+
+/// Length of a CCM* nonce, in bytes.
+#define CRYPTOENGINE_NONCE_LENGTH     13
+
+/// Longest authentication tag CCM* produces, in bytes.
+#define CRYPTOENGINE_MAX_MIC_LENGTH   16
+
+// the engine is chosen at build time, with the cryptoengine= SCons option
+#ifdef CRYPTO_ENGINE_SCONS
+#define CRYPTO_ENGINE                 CRYPTO_ENGINE_SCONS
+#else
+#define CRYPTO_ENGINE                 firmware_crypto_engine
+#endif
+
+//=========================== typedef =========================================
+
+typedef owerror_t (*crypto_init_cbt)(uint8_t* key);
+typedef owerror_t (*crypto_aes_ccms_mic_cbt)(uint8_t* a, uint8_t len_a, uint8_t* nonce, uint8_t* mic, uint8_t micLength);
+
+/**
+\brief Operations of a crypto engine.
+
+All engines authenticate with CCM*, L=2, without encryption: the whole frame is
+authentication-only data. The key is loaded once, by init, so each frame only
+costs the CBC-MAC of its blocks and the encryption of the tag.
+*/
+typedef struct {
+   crypto_init_cbt          crypto_init;   ///< load the key, expanding it if the engine needs to
+   crypto_aes_ccms_mic_cbt  aes_ccms_mic;  ///< micLength-byte authentication tag of a[0..len_a-1]
+} crypto_engine_t;
+
+//=========================== variables =======================================
+
+extern const crypto_engine_t CRYPTO_ENGINE;
+
+//=========================== prototypes ======================================
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -0,0 +1,48 @@
+/**
+\brief Dummy implementation of the "cryptoengine" driver.
+
+Writes an all-zero tag, so frames keep the layout of secured frames without
+the cost of AES. For debugging only, it authenticates nothing.
+*/
+
+#include "opendefs.h"
+#include "cryptoengine.h"
+
+//=========================== define ==========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+owerror_t dummy_crypto_engine_init(uint8_t* key);
+owerror_t dummy_crypto_engine_aes_ccms_mic(
+   uint8_t*    a,
+   uint8_t     len_a,
+   uint8_t*    nonce,
+   uint8_t*    mic,
+   uint8_t     micLength
+);
+
+const crypto_engine_t dummy_crypto_engine = {
+   dummy_crypto_engine_init,
+   dummy_crypto_engine_aes_ccms_mic,
+};
+
+//=========================== public ==========================================
+
+owerror_t dummy_crypto_engine_init(uint8_t* key) {
+   return E_SUCCESS;
+}
+
+owerror_t dummy_crypto_engine_aes_ccms_mic(
+      uint8_t*    a,
+      uint8_t     len_a,
+      uint8_t*    nonce,
+      uint8_t*    mic,
+      uint8_t     micLength
+   ) {
+   memset(mic,0,micLength);
+   return E_SUCCESS;
+}
+
+//=========================== private =========================================
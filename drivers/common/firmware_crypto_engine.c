@@ -0,0 +1,236 @@
+/**
+\brief Software implementation of the "cryptoengine" driver.
+
+AES-128, encryption only, with the expanded key kept in RAM between frames.
+Used by the boards without an AES coprocessor, and by the python simulator.
+*/
+
+#include "opendefs.h"
+#include "cryptoengine.h"
+
+//=========================== define ==========================================
+
+#define AES_NUMROUNDS         10
+#define AES_EXPANDEDKEYLENGTH ((AES_NUMROUNDS+1)*CRYPTOENGINE_AES_BLOCK_LENGTH)
+
+static const uint8_t aes_sbox[256] = {
+   0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
+   0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
+   0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
+   0x04,0xc7,0x23,0xc3,0x18,0x96,0x05,0x9a,0x07,0x12,0x80,0xe2,0xeb,0x27,0xb2,0x75,
+   0x09,0x83,0x2c,0x1a,0x1b,0x6e,0x5a,0xa0,0x52,0x3b,0xd6,0xb3,0x29,0xe3,0x2f,0x84,
+   0x53,0xd1,0x00,0xed,0x20,0xfc,0xb1,0x5b,0x6a,0xcb,0xbe,0x39,0x4a,0x4c,0x58,0xcf,
+   0xd0,0xef,0xaa,0xfb,0x43,0x4d,0x33,0x85,0x45,0xf9,0x02,0x7f,0x50,0x3c,0x9f,0xa8,
+   0x51,0xa3,0x40,0x8f,0x92,0x9d,0x38,0xf5,0xbc,0xb6,0xda,0x21,0x10,0xff,0xf3,0xd2,
+   0xcd,0x0c,0x13,0xec,0x5f,0x97,0x44,0x17,0xc4,0xa7,0x7e,0x3d,0x64,0x5d,0x19,0x73,
+   0x60,0x81,0x4f,0xdc,0x22,0x2a,0x90,0x88,0x46,0xee,0xb8,0x14,0xde,0x5e,0x0b,0xdb,
+   0xe0,0x32,0x3a,0x0a,0x49,0x06,0x24,0x5c,0xc2,0xd3,0xac,0x62,0x91,0x95,0xe4,0x79,
+   0xe7,0xc8,0x37,0x6d,0x8d,0xd5,0x4e,0xa9,0x6c,0x56,0xf4,0xea,0x65,0x7a,0xae,0x08,
+   0xba,0x78,0x25,0x2e,0x1c,0xa6,0xb4,0xc6,0xe8,0xdd,0x74,0x1f,0x4b,0xbd,0x8b,0x8a,
+   0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
+   0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,
+   0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16,
+};
+
+//=========================== variables =======================================
+
+typedef struct {
+   uint8_t    expandedKey[AES_EXPANDEDKEYLENGTH]; // round keys, computed once by init
+} firmware_crypto_engine_vars_t;
+
+firmware_crypto_engine_vars_t firmware_crypto_engine_vars;
+
+//=========================== prototypes ======================================
+
+owerror_t firmware_crypto_engine_init(uint8_t* key);
+owerror_t firmware_crypto_engine_aes_ccms_mic(
+   uint8_t*    a,
+   uint8_t     len_a,
+   uint8_t*    nonce,
+   uint8_t*    mic,
+   uint8_t     micLength
+);
+uint8_t   firmware_crypto_engine_xtime(uint8_t x);
+void      firmware_crypto_engine_aes_ecb_enc(uint8_t* block);
+
+const crypto_engine_t firmware_crypto_engine = {
+   firmware_crypto_engine_init,
+   firmware_crypto_engine_aes_ccms_mic,
+};
+
+//=========================== public ==========================================
+
+/**
+\brief Expand the key into the round keys.
+
+\param[in] key The 16-byte key.
+
+\returns E_SUCCESS.
+*/
+owerror_t firmware_crypto_engine_init(uint8_t* key) {
+   uint8_t* rk;
+   uint8_t  i;
+   uint8_t  t[4];
+   uint8_t  rcon;
+
+   rk   = firmware_crypto_engine_vars.expandedKey;
+   memcpy(rk,key,CRYPTOENGINE_AES_BLOCK_LENGTH);
+
+   rcon = 0x01;
+   for (i=CRYPTOENGINE_AES_BLOCK_LENGTH;i<AES_EXPANDEDKEYLENGTH;i+=4) {
+      t[0] = rk[i-4];
+      t[1] = rk[i-3];
+      t[2] = rk[i-2];
+      t[3] = rk[i-1];
+      if (i%CRYPTOENGINE_AES_BLOCK_LENGTH==0) {
+         // RotWord, SubWord, Rcon
+         t[0] = aes_sbox[rk[i-3]]^rcon;
+         t[1] = aes_sbox[rk[i-2]];
+         t[2] = aes_sbox[rk[i-1]];
+         t[3] = aes_sbox[rk[i-4]];
+         rcon = firmware_crypto_engine_xtime(rcon);
+      }
+      rk[i+0] = rk[i+0-CRYPTOENGINE_AES_BLOCK_LENGTH]^t[0];
+      rk[i+1] = rk[i+1-CRYPTOENGINE_AES_BLOCK_LENGTH]^t[1];
+      rk[i+2] = rk[i+2-CRYPTOENGINE_AES_BLOCK_LENGTH]^t[2];
+      rk[i+3] = rk[i+3-CRYPTOENGINE_AES_BLOCK_LENGTH]^t[3];
+   }
+   return E_SUCCESS;
+}
+
+/**
+\brief CCM* authentication tag of a, without encryption.
+
+\param[in]  a         The data to authenticate.
+\param[in]  len_a     Its length, in bytes.
+\param[in]  nonce     The 13-byte nonce.
+\param[out] mic       Where to write the tag.
+\param[in]  micLength The length of the tag, 4, 8 or 16 bytes.
+
+\returns E_SUCCESS, or E_FAIL on an invalid tag length.
+*/
+owerror_t firmware_crypto_engine_aes_ccms_mic(
+      uint8_t*    a,
+      uint8_t     len_a,
+      uint8_t*    nonce,
+      uint8_t*    mic,
+      uint8_t     micLength
+   ) {
+   uint8_t  x[CRYPTOENGINE_AES_BLOCK_LENGTH];
+   uint8_t  s0[CRYPTOENGINE_AES_BLOCK_LENGTH];
+   uint8_t  i;
+   uint8_t  pos;
+
+   if (micLength<4 || micLength>CRYPTOENGINE_MAX_MIC_LENGTH || micLength%2!=0) {
+      return E_FAIL;
+   }
+
+   // B0: flags, nonce, no message
+   x[0]  = ((len_a>0)<<6) | (((micLength-2)/2)<<3) | (2-1);
+   memcpy(&x[1],nonce,CRYPTOENGINE_NONCE_LENGTH);
+   x[14] = 0;
+   x[15] = 0;
+   firmware_crypto_engine_aes_ecb_enc(x);
+
+   // chain the 2-byte length of a, then a, zero-padded to whole blocks
+   if (len_a>0) {
+      x[1] ^= len_a; // len_a fits in the low byte
+      pos   = 2;
+      for (i=0;i<len_a;i++) {
+         x[pos++] ^= a[i];
+         if (pos==CRYPTOENGINE_AES_BLOCK_LENGTH) {
+            firmware_crypto_engine_aes_ecb_enc(x);
+            pos = 0;
+         }
+      }
+      if (pos>0) {
+         firmware_crypto_engine_aes_ecb_enc(x);
+      }
+   }
+
+   // encrypt the tag with the first key stream block A0
+   s0[0]  = (2-1);
+   memcpy(&s0[1],nonce,CRYPTOENGINE_NONCE_LENGTH);
+   s0[14] = 0;
+   s0[15] = 0;
+   firmware_crypto_engine_aes_ecb_enc(s0);
+
+   for (i=0;i<micLength;i++) {
+      mic[i] = x[i]^s0[i];
+   }
+   return E_SUCCESS;
+}
+
+//=========================== private =========================================
+
+/**
+\brief Multiply by x in GF(2^8), modulo the AES polynomial.
+*/
+port_INLINE uint8_t firmware_crypto_engine_xtime(uint8_t x) {
+   return (uint8_t)((x<<1)^((x&0x80)?0x1b:0x00));
+}
+
+/**
+\brief Encrypt a block in place with the expanded key.
+
+\param[in,out] block The 16-byte block.
+*/
+void firmware_crypto_engine_aes_ecb_enc(uint8_t* block) {
+   uint8_t* rk;
+   uint8_t  round;
+   uint8_t  i;
+   uint8_t  t;
+   uint8_t  u;
+   uint8_t  c[4];
+
+   rk = firmware_crypto_engine_vars.expandedKey;
+
+   for (i=0;i<CRYPTOENGINE_AES_BLOCK_LENGTH;i++) {
+      block[i] ^= rk[i];
+   }
+
+   for (round=1;round<=AES_NUMROUNDS;round++) {
+      // SubBytes
+      for (i=0;i<CRYPTOENGINE_AES_BLOCK_LENGTH;i++) {
+         block[i] = aes_sbox[block[i]];
+      }
+
+      // ShiftRows, the state is stored column by column
+      t         = block[1];
+      block[1]  = block[5];
+      block[5]  = block[9];
+      block[9]  = block[13];
+      block[13] = t;
+      t         = block[2];
+      block[2]  = block[10];
+      block[10] = t;
+      t         = block[6];
+      block[6]  = block[14];
+      block[14] = t;
+      t         = block[15];
+      block[15] = block[11];
+      block[11] = block[7];
+      block[7]  = block[3];
+      block[3]  = t;
+
+      // MixColumns, except in the last round
+      if (round<AES_NUMROUNDS) {
+         for (i=0;i<CRYPTOENGINE_AES_BLOCK_LENGTH;i+=4) {
+            c[0] = block[i+0];
+            c[1] = block[i+1];
+            c[2] = block[i+2];
+            c[3] = block[i+3];
+            u    = c[0]^c[1]^c[2]^c[3];
+            block[i+0] ^= u^firmware_crypto_engine_xtime(c[0]^c[1]);
+            block[i+1] ^= u^firmware_crypto_engine_xtime(c[1]^c[2]);
+            block[i+2] ^= u^firmware_crypto_engine_xtime(c[2]^c[3]);
+            block[i+3] ^= u^firmware_crypto_engine_xtime(c[3]^c[0]);
+         }
+      }
+
+      // AddRoundKey
+      for (i=0;i<CRYPTOENGINE_AES_BLOCK_LENGTH;i++) {
+         block[i] ^= rk[round*CRYPTOENGINE_AES_BLOCK_LENGTH+i];
+      }
+   }
+}
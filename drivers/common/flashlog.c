@@ -0,0 +1,359 @@
+/**
+\brief Definition of the "flashlog" driver.
+
+A ring of records in the flash pages of the nvm bsp module, holding the info,
+error, critical and data frames openserial prints, with the ASN they were
+printed at. It survives reboots, so the frames of a mote deployed without a
+serial cable can be dumped once it is back.
+
+Records are appended to a RAM buffer, and written to flash only in the windows
+the MAC hands over when the radio is idle, since flash operations stall the
+CPU. Each page starts with a word holding FLASHLOG_PAGE_MAGIC and a sequence
+number; the page with the highest one is the head of the ring. Pages are used,
+and thus erased, in turn, which levels the wear. The page after the head is
+kept erased so rolling over to it does not wait for an erase.
+
+A page erase is much longer than a program and than any idle time the schedule
+leaves: once the page after the head is used, the MAC skips a few slots with
+the radio off to hand over a window long enough for it, see
+flashlog_needsErase(). If the head page fills up before then, records are
+dropped and counted.
+*/
+
+#include "opendefs.h"
+#include "flashlog.h"
+#include "openserial.h"
+#include "IEEE802154E.h"
+
+//=========================== define ==========================================
+
+// record of a frame of length bytes, padded to whole words
+#define FLASHLOG_RECORD_SIZE(length) (((FLASHLOG_RECORD_HEADER+(length))+3)&~3)
+
+//=========================== variables =======================================
+
+#ifdef BOARD_NVM
+flashlog_vars_t flashlog_vars;
+#endif
+
+//=========================== prototypes ======================================
+
+#ifdef BOARD_NVM
+uint32_t  flashlog_readPageHeader(uint8_t page);
+bool      flashlog_isPageErased(uint8_t page);
+void      flashlog_startPage(uint8_t page, uint16_t seq);
+#endif
+
+//=========================== public ==========================================
+
+/**
+\brief Find the head of the ring left by the previous run.
+
+Called at boot, before the MAC runs, so the page after the head can be erased
+right away if it is not.
+*/
+void flashlog_init() {
+#ifdef BOARD_NVM
+   uint32_t  header;
+   bool      found;
+   uint8_t   page;
+   uint8_t   length;
+
+   memset(&flashlog_vars,0,sizeof(flashlog_vars_t));
+
+   // the head is the page with the highest sequence number
+   found = FALSE;
+   for (page=0;page<NVM_NUMPAGES;page++) {
+      header = flashlog_readPageHeader(page);
+      if ((header>>16)!=FLASHLOG_PAGE_MAGIC) {
+         continue;
+      }
+      if (found==FALSE || (int16_t)((uint16_t)header-flashlog_vars.headSeq)>0) {
+         found                   = TRUE;
+         flashlog_vars.headPage  = page;
+         flashlog_vars.headSeq   = (uint16_t)header;
+      }
+   }
+
+   if (found==FALSE) {
+      // empty ring
+      nvm_erasePage(0);
+      flashlog_startPage(0,0);
+   } else {
+      // skip the records already in the head page
+      flashlog_vars.headOffset = sizeof(uint32_t);
+      while (flashlog_vars.headOffset<NVM_PAGE_SIZE) {
+         nvm_read(flashlog_vars.headPage,flashlog_vars.headOffset,&length,sizeof(length));
+         if (length==FLASHLOG_LENGTH_ERASED) {
+            break;
+         }
+         flashlog_vars.headOffset += FLASHLOG_RECORD_SIZE(length);
+      }
+   }
+
+   page = (flashlog_vars.headPage+1)%NVM_NUMPAGES;
+   if (flashlog_isPageErased(page)==FALSE) {
+      // drops the oldest page of the previous run
+      nvm_erasePage(page);
+   }
+   flashlog_vars.nextErased = TRUE;
+#endif
+}
+
+/**
+\brief Append a frame to the log.
+
+The frame is made of header, then body, and is cut to FLASHLOG_MAX_FRAME_LENGTH
+bytes. It is kept in RAM until the next window; if there is no room left, it
+is dropped.
+
+\param[in] header       The first part of the frame.
+\param[in] headerLength The number of bytes in header.
+\param[in] body         The second part of the frame, may be NULL.
+\param[in] bodyLength   The number of bytes in body.
+*/
+void flashlog_append(uint8_t* header, uint8_t headerLength, uint8_t* body, uint8_t bodyLength) {
+#ifdef BOARD_NVM
+   uint8_t*  record;
+   uint8_t   length;
+   uint16_t  size;
+   INTERRUPT_DECLARATION();
+
+   if (headerLength>FLASHLOG_MAX_FRAME_LENGTH) {
+      headerLength = FLASHLOG_MAX_FRAME_LENGTH;
+   }
+   if (bodyLength>FLASHLOG_MAX_FRAME_LENGTH-headerLength) {
+      bodyLength   = FLASHLOG_MAX_FRAME_LENGTH-headerLength;
+   }
+   length = headerLength+bodyLength;
+   size   = FLASHLOG_RECORD_SIZE(length);
+
+   DISABLE_INTERRUPTS();
+   if (flashlog_vars.bufFill+size>FLASHLOG_BUFFER_SIZE) {
+      flashlog_vars.numDropped++;
+      ENABLE_INTERRUPTS();
+      return;
+   }
+   record = (uint8_t*)flashlog_vars.buf+flashlog_vars.bufFill;
+   memset(record,FLASHLOG_LENGTH_ERASED,size);
+   record[0] = length;
+   ieee154e_getAsn(&record[1]);
+   memcpy(&record[FLASHLOG_RECORD_HEADER],header,headerLength);
+   memcpy(&record[FLASHLOG_RECORD_HEADER+headerLength],body,bodyLength);
+   flashlog_vars.bufFill += size;
+   ENABLE_INTERRUPTS();
+#endif
+}
+
+/**
+\brief Whether the page after the head still has to be erased.
+
+The MAC then hands over a window of at least NVM_ERASE_TICKS, with the radio
+off, as no other window is that long once it is synchronized.
+*/
+bool flashlog_needsErase() {
+#ifdef BOARD_NVM
+   return flashlog_vars.nextErased==FALSE;
+#else
+   return FALSE;
+#endif
+}
+
+/**
+\brief Whether records are waiting in the RAM buffer for a window.
+*/
+bool flashlog_hasRecords() {
+#ifdef BOARD_NVM
+   return flashlog_vars.bufFill>0;
+#else
+   return FALSE;
+#endif
+}
+
+/**
+\brief Write the buffered records to flash.
+
+Called by the MAC when the radio goes idle, with the number of ticks until it
+needs the CPU again. Erases the page after the head first if it is not yet and
+the window is long enough, then writes as many whole records as fit in the
+rest of the window.
+
+\param[in] ticks Number of ticks until the radio needs the CPU.
+*/
+void flashlog_startWindow(uint16_t ticks) {
+#ifdef BOARD_NVM
+   uint16_t  budget;
+   uint16_t  fill;
+   uint16_t  done;
+   uint16_t  size;
+   uint8_t*  record;
+   INTERRUPT_DECLARATION();
+
+   if (ticks<=FLASHLOG_WINDOW_GUARD_TICKS) {
+      return;
+   }
+   ticks -= FLASHLOG_WINDOW_GUARD_TICKS;
+
+   // records may be waiting for the next page, erase it first
+   if (flashlog_vars.nextErased==FALSE && ticks>=NVM_ERASE_TICKS) {
+      nvm_erasePage((flashlog_vars.headPage+1)%NVM_NUMPAGES);
+      flashlog_vars.nextErased = TRUE;
+      ticks -= NVM_ERASE_TICKS;
+   }
+
+   // number of words which can be programmed in the rest of this window
+   budget = (uint16_t)(((uint32_t)ticks*NVM_WORDS_PER_1024_TICKS)>>10);
+
+   // records appended from now on wait for the next window
+   DISABLE_INTERRUPTS();
+   fill = flashlog_vars.bufFill;
+   ENABLE_INTERRUPTS();
+
+   done = 0;
+   while (done<fill) {
+      record = (uint8_t*)flashlog_vars.buf+done;
+      size   = FLASHLOG_RECORD_SIZE(record[0]);
+
+      if (flashlog_vars.headOffset+size>NVM_PAGE_SIZE) {
+         // the head page is full, move on to the next one
+         if (flashlog_vars.nextErased==FALSE || budget<1+size/4) {
+            break;
+         }
+         flashlog_startPage((flashlog_vars.headPage+1)%NVM_NUMPAGES,flashlog_vars.headSeq+1);
+         flashlog_vars.nextErased = FALSE;
+         budget--;
+      }
+
+      if (size/4>budget) {
+         break;
+      }
+      nvm_programWords(flashlog_vars.headPage,flashlog_vars.headOffset,(uint32_t*)record,size/4);
+      flashlog_vars.headOffset += size;
+      budget                   -= size/4;
+      done                     += size;
+   }
+
+   if (done>0) {
+      DISABLE_INTERRUPTS();
+      memmove(flashlog_vars.buf,(uint8_t*)flashlog_vars.buf+done,flashlog_vars.bufFill-done);
+      flashlog_vars.bufFill -= done;
+      ENABLE_INTERRUPTS();
+   }
+#endif
+}
+
+/**
+\brief Start dumping the log over the serial port, oldest record first.
+
+Called when the PC sends a SERFRAME_PC2MOTE_FLASHLOG frame. The records are
+sent as SERFRAME_MOTE2PC_FLASHLOG frames each time openserial starts output,
+as fast as the serial bandwidth allows, i.e. at full speed when the mote is
+not synchronized. A frame holding only the number of dropped records ends the
+dump.
+*/
+void flashlog_startDump() {
+#ifdef BOARD_NVM
+   flashlog_vars.dumping       = TRUE;
+   flashlog_vars.dumpPage      = (flashlog_vars.headPage+1)%NVM_NUMPAGES;
+   flashlog_vars.dumpOffset    = 0;
+   flashlog_vars.dumpPagesLeft = NVM_NUMPAGES-1;
+#endif
+}
+
+/**
+\brief Hand openserial as many records of the dump as fit in its output buffer.
+*/
+void flashlog_dumpNext() {
+#ifdef BOARD_NVM
+   uint8_t   record[FLASHLOG_RECORD_HEADER+FLASHLOG_MAX_FRAME_LENGTH];
+   uint8_t   numDropped[2];
+   bool      endOfPage;
+
+   while (flashlog_vars.dumping==TRUE) {
+      endOfPage = FALSE;
+      if (flashlog_vars.dumpOffset==0) {
+         // start of a page, skip it if it is not in use
+         if ((flashlog_readPageHeader(flashlog_vars.dumpPage)>>16)==FLASHLOG_PAGE_MAGIC) {
+            flashlog_vars.dumpOffset = sizeof(uint32_t);
+         } else {
+            endOfPage = TRUE;
+         }
+      } else if (flashlog_vars.dumpOffset>=NVM_PAGE_SIZE) {
+         endOfPage = TRUE;
+      } else {
+         nvm_read(flashlog_vars.dumpPage,flashlog_vars.dumpOffset,record,1);
+         if (record[0]==FLASHLOG_LENGTH_ERASED || record[0]>FLASHLOG_MAX_FRAME_LENGTH) {
+            endOfPage = TRUE;
+         } else {
+            nvm_read(
+               flashlog_vars.dumpPage,
+               flashlog_vars.dumpOffset,
+               record,
+               FLASHLOG_RECORD_HEADER+record[0]
+            );
+            if (openserial_printFlashlog(&record[1],FLASHLOG_RECORD_HEADER-1+record[0])!=E_SUCCESS) {
+               // no room left, resume at the next output window
+               return;
+            }
+            flashlog_vars.dumpOffset += FLASHLOG_RECORD_SIZE(record[0]);
+         }
+      }
+
+      if (endOfPage==FALSE) {
+         continue;
+      }
+
+      if (flashlog_vars.dumpPagesLeft>0) {
+         flashlog_vars.dumpPage   = (flashlog_vars.dumpPage+1)%NVM_NUMPAGES;
+         flashlog_vars.dumpOffset = 0;
+         flashlog_vars.dumpPagesLeft--;
+      } else {
+         // end of the dump
+         numDropped[0] = (uint8_t)(flashlog_vars.numDropped>>8);
+         numDropped[1] = (uint8_t)(flashlog_vars.numDropped&0xff);
+         if (openserial_printFlashlog(numDropped,sizeof(numDropped))!=E_SUCCESS) {
+            return;
+         }
+         flashlog_vars.dumping = FALSE;
+      }
+   }
+#endif
+}
+
+//=========================== private =========================================
+
+#ifdef BOARD_NVM
+uint32_t flashlog_readPageHeader(uint8_t page) {
+   uint32_t header;
+
+   nvm_read(page,0,(uint8_t*)&header,sizeof(header));
+   return header;
+}
+
+bool flashlog_isPageErased(uint8_t page) {
+   uint32_t word;
+   uint16_t offset;
+
+   for (offset=0;offset<NVM_PAGE_SIZE;offset+=sizeof(word)) {
+      nvm_read(page,offset,(uint8_t*)&word,sizeof(word));
+      if (word!=0xffffffff) {
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/**
+\brief Make an erased page the head of the ring.
+*/
+void flashlog_startPage(uint8_t page, uint16_t seq) {
+   uint32_t header;
+
+   header = ((uint32_t)FLASHLOG_PAGE_MAGIC<<16) | seq;
+   nvm_programWords(page,0,&header,1);
+
+   flashlog_vars.headPage   = page;
+   flashlog_vars.headSeq    = seq;
+   flashlog_vars.headOffset = sizeof(uint32_t);
+}
+#endif
@@ -0,0 +1,85 @@
+/**
+\brief Declaration of the "flashlog" driver.
+*/
+
+#ifndef __FLASHLOG_H
+#define __FLASHLOG_H
+
+#include "opendefs.h"
+#include "nvm.h"
+
+/**
+\addtogroup drivers
+\{
+\addtogroup Flashlog
+\{
+*/
+
+//=========================== define ==========================================
+
+/**
+\brief Size of the RAM buffer of records waiting to be written, in bytes.
+
+\warning Must be a multiple of 4, flash is programmed one word at a time.
+*/
+#define FLASHLOG_BUFFER_SIZE        256
+
+/// Marks a page in use, in the upper half of its first word.
+#define FLASHLOG_PAGE_MAGIC         0x4c47
+
+/// Length byte of the erased flash, there is no record from there on.
+#define FLASHLOG_LENGTH_ERASED      0xff
+
+/// Bytes written before the frame of each record: length (1B) and ASN (5B).
+#define FLASHLOG_RECORD_HEADER      6
+
+/**
+\brief Longest frame a record holds, in bytes.
+
+Longer frames are cut. Keeps a dumped record, HDLC-escaped in the worst case,
+within the DATA lane of openserial.
+*/
+#define FLASHLOG_MAX_FRAME_LENGTH   48
+
+/// Ticks kept free at the end of a window, so the flash is done when the radio needs the CPU.
+#define FLASHLOG_WINDOW_GUARD_TICKS 5
+
+//=========================== typedef =========================================
+
+//=========================== module variables ================================
+
+#ifdef BOARD_NVM
+typedef struct {
+   // RAM buffer
+   uint32_t   buf[FLASHLOG_BUFFER_SIZE/4]; // records waiting for an idle window, each padded to whole words
+   uint16_t   bufFill;       // bytes in buf
+   // head of the ring
+   uint8_t    headPage;      // page records are written to
+   uint16_t   headOffset;    // offset of the next record in headPage
+   uint16_t   headSeq;       // sequence number of headPage, increments at each new page
+   bool       nextErased;    // is the page after headPage erased, ready to be used?
+   uint16_t   numDropped;    // records dropped because buf was full or no page was ready
+   // dump
+   bool       dumping;       // is a dump in progress?
+   uint8_t    dumpPage;      // page being dumped
+   uint16_t   dumpOffset;    // offset of the next record to dump
+   uint8_t    dumpPagesLeft; // pages still to dump after dumpPage
+} flashlog_vars_t;
+#endif
+
+//=========================== prototypes ======================================
+
+void      flashlog_init(void);
+void      flashlog_append(uint8_t* header, uint8_t headerLength, uint8_t* body, uint8_t bodyLength);
+bool      flashlog_needsErase(void);
+bool      flashlog_hasRecords(void);
+void      flashlog_startWindow(uint16_t ticks);
+void      flashlog_startDump(void);
+void      flashlog_dumpNext(void);
+
+/**
+\}
+\}
+*/
+
+#endif
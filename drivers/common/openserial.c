@@ -18,7 +18,11 @@
 #include "uart.h"
 #include "opentimers.h"
 #include "openhdlc.h"
+#include "telemetry.h"
 #include "schedule.h"
+#include "flashlog.h"
+#include "energy.h"
+#include "scheduler.h"
 //#include "icmpv6rpl.h"
 
 //=========================== variables =======================================
@@ -45,10 +49,28 @@ void openserial_board_reset_cb(
 
 void openserial_goldenImageCommands(void);
 
+void openserial_statusTask(void);
+
 // HDLC output
-void outputHdlcOpen(void);
-void outputHdlcWrite(uint8_t b);
-void outputHdlcClose(void);
+owerror_t outputHdlcFrame(
+   uint8_t          lane,
+   uint8_t*         header,
+   uint8_t          headerLength,
+   uint8_t*         body,
+   uint8_t          bodyLength,
+   uint8_t*         trailer,
+   uint8_t          trailerLength
+);
+void outputHdlcWriteBuffer(uint8_t lane, uint8_t* buffer, uint8_t length);
+void outputBufCopy(uint8_t lane, uint8_t* buffer, uint8_t length);
+bool outputBufNextByte(uint8_t* b);
+bool outputBufIsEmpty(void);
+#ifdef BOARD_UART_DMA_TX
+uint16_t outputBufNextSegment(uint8_t** segment, uint16_t maxLength);
+#endif
+bool outputSendNext(void);
+// bandwidth
+uint16_t openserial_ticksToBytes(uint16_t ticks);
 // HDLC input
 void inputHdlcOpen(void);
 void inputHdlcWrite(uint8_t b);
@@ -65,6 +87,7 @@ void openserial_init() {
    // admin
    openserial_vars.mode                = MODE_OFF;
    openserial_vars.debugPrintCounter   = 0;
+   openserial_vars.statusTaskPending   = FALSE;
    
    // input
    openserial_vars.reqFrame[0]         = HDLC_FLAG;
@@ -82,34 +105,82 @@ void openserial_init() {
    openserial_vars.inputBufFill        = 0;
    
    // ouput
-   openserial_vars.outputBufFilled     = FALSE;
-   openserial_vars.outputBufIdxR       = 0;
-   openserial_vars.outputBufIdxW       = 0;
+   openserial_vars.outputLaneR         = SERIAL_LANE_ERROR;
+   openserial_vars.outputInFrame       = FALSE;
+   openserial_vars.outputLanes[SERIAL_LANE_ERROR].base  = 0;
+   openserial_vars.outputLanes[SERIAL_LANE_ERROR].mask  = SERIAL_OUTPUT_LANE_ERROR_SIZE-1;
+   openserial_vars.outputLanes[SERIAL_LANE_DATA].base   = SERIAL_OUTPUT_LANE_ERROR_SIZE;
+   openserial_vars.outputLanes[SERIAL_LANE_DATA].mask   = SERIAL_OUTPUT_LANE_DATA_SIZE-1;
+   openserial_vars.outputLanes[SERIAL_LANE_STATUS].base = SERIAL_OUTPUT_LANE_ERROR_SIZE+SERIAL_OUTPUT_LANE_DATA_SIZE;
+   openserial_vars.outputLanes[SERIAL_LANE_STATUS].mask = SERIAL_OUTPUT_LANE_STATUS_SIZE-1;
+   
+   // status elements are sent as deltas
+   telemetry_init();
    
    // set callbacks
    uart_setCallbacks(isr_openserial_tx,
                      isr_openserial_rx);
 }
 
+/**
+\brief Print a status element.
+
+The element is sent as a telemetry frame holding only the bytes which changed
+since the last version the PC got, and not at all if nothing changed. Elements
+the telemetry module can not track are sent in full, in a status frame.
+*/
 owerror_t openserial_printStatus(uint8_t statusElement,uint8_t* buffer, uint8_t length) {
 #ifdef ENABLE_OPENSERIAL
-  uint8_t i;
+   uint8_t   header[4];
+   uint8_t   body[TELEMETRY_MAX_BODY_LENGTH];
+   uint8_t   bodyLength;
+   uint8_t   snapshot[TELEMETRY_MAX_LENGTH];
+   uint8_t   slot;
+   owerror_t outcome;
    INTERRUPT_DECLARATION();
    
-   DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
-   outputHdlcWrite(SERFRAME_MOTE2PC_STATUS);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
-   outputHdlcWrite(statusElement);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
-   }
-   outputHdlcClose();
-   ENABLE_INTERRUPTS();
-#endif
+   header[1] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
+   header[2] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   header[3] = statusElement;
+   
+   // the element may change under an interrupt, encode and keep the version sent
+   if (length<=sizeof(snapshot)) {
+      DISABLE_INTERRUPTS();
+      memcpy(snapshot,buffer,length);
+      ENABLE_INTERRUPTS();
+      buffer = snapshot;
+   }
+   
+   slot = telemetry_encode(statusElement,buffer,length,body,&bodyLength);
+   if (slot==TELEMETRY_SLOT_NONE) {
+      header[0] = SERFRAME_MOTE2PC_STATUS;
+      return outputHdlcFrame(
+         SERIAL_LANE_STATUS,
+         header,sizeof(header),
+         buffer,length,
+         NULL,0
+      );
+   }
+   
+   if (bodyLength==0) {
+      // the PC already has this version
+      return E_SUCCESS;
+   }
+   
+   header[0] = SERFRAME_MOTE2PC_TELEMETRY;
+   outcome = outputHdlcFrame(
+      SERIAL_LANE_STATUS,
+      header,sizeof(header),
+      body,bodyLength,
+      NULL,0
+   );
+   if (outcome==E_SUCCESS) {
+      telemetry_sent(slot,buffer);
+   }
+   return outcome;
+#else
    return E_SUCCESS;
+#endif
 }
 
 owerror_t openserial_printInfoErrorCritical(
@@ -120,75 +191,102 @@ owerror_t openserial_printInfoErrorCritical(
       errorparameter_t arg2
    ) {
 #ifdef ENABLE_OPENSERIAL
-   INTERRUPT_DECLARATION();
+   uint8_t frame[9];
    
-   DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
-   outputHdlcWrite(severity);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
-   outputHdlcWrite(calling_component);
-   outputHdlcWrite(error_code);
-   outputHdlcWrite((uint8_t)((arg1 & 0xff00)>>8));
-   outputHdlcWrite((uint8_t) (arg1 & 0x00ff));
-   outputHdlcWrite((uint8_t)((arg2 & 0xff00)>>8));
-   outputHdlcWrite((uint8_t) (arg2 & 0x00ff));
-   outputHdlcClose();
-   ENABLE_INTERRUPTS();
-#endif
+   frame[0] = severity;
+   frame[1] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
+   frame[2] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   frame[3] = calling_component;
+   frame[4] = error_code;
+   frame[5] = (uint8_t)((arg1 & 0xff00)>>8);
+   frame[6] = (uint8_t) (arg1 & 0x00ff);
+   frame[7] = (uint8_t)((arg2 & 0xff00)>>8);
+   frame[8] = (uint8_t) (arg2 & 0x00ff);
+   
+   flashlog_append(frame,sizeof(frame),NULL,0);
+   
+   return outputHdlcFrame(
+      SERIAL_LANE_ERROR,
+      frame,sizeof(frame),
+      NULL,0,
+      NULL,0
+   );
+#else
    return E_SUCCESS;
+#endif
 }
 
 owerror_t openserial_printData(uint8_t* buffer, uint8_t length) {
 #ifdef ENABLE_OPENSERIAL
-   uint8_t  i;
-   uint8_t  asn[5];
-   INTERRUPT_DECLARATION();
+   uint8_t  header[1+2+5];
+   
+   header[0] = SERFRAME_MOTE2PC_DATA;
+   header[1] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   header[2] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
    
    // retrieve ASN
-   ieee154e_getAsn(asn);// byte01,byte23,byte4
+   ieee154e_getAsn(&header[3]);// byte01,byte23,byte4
    
-   DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
-   outputHdlcWrite(SERFRAME_MOTE2PC_DATA);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   outputHdlcWrite(asn[0]);
-   outputHdlcWrite(asn[1]);
-   outputHdlcWrite(asn[2]);
-   outputHdlcWrite(asn[3]);
-   outputHdlcWrite(asn[4]);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
-   }
-   outputHdlcClose();
-   ENABLE_INTERRUPTS();
-#endif
+   flashlog_append(header,sizeof(header),buffer,length);
+   
+   return outputHdlcFrame(
+      SERIAL_LANE_DATA,
+      header,sizeof(header),
+      buffer,length,
+      NULL,0
+   );
+#else
    return E_SUCCESS;
+#endif
 }
 
 owerror_t openserial_printPacket(uint8_t* buffer, uint8_t length, uint8_t channel) {
 #ifdef ENABLE_OPENSERIAL
-   uint8_t  i;
-   INTERRUPT_DECLARATION();
+   uint8_t  header[3];
    
-   DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
-   outputHdlcWrite(SERFRAME_MOTE2PC_SNIFFED_PACKET);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
-   outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
-   }
-   outputHdlcWrite(channel);
-   outputHdlcClose();
+   header[0] = SERFRAME_MOTE2PC_SNIFFED_PACKET;
+   header[1] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   header[2] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
    
-   ENABLE_INTERRUPTS();
-#endif
+   return outputHdlcFrame(
+      SERIAL_LANE_DATA,
+      header,sizeof(header),
+      buffer,length,
+      &channel,sizeof(channel)
+   );
+#else
    return E_SUCCESS;
+#endif
+}
+
+/**
+\brief Print a record of the flash log, while it is being dumped.
+
+Unlike the other frames, these are not written to the flash log themselves.
+
+\param[in] buffer The record, i.e. its ASN then the frame it holds.
+\param[in] length The number of bytes in buffer.
+
+\returns E_SUCCESS if the frame was written, E_FAIL if the output buffer is
+   full and the record has to be printed again later.
+*/
+owerror_t openserial_printFlashlog(uint8_t* buffer, uint8_t length) {
+#ifdef ENABLE_OPENSERIAL
+   uint8_t  header[3];
+   
+   header[0] = SERFRAME_MOTE2PC_FLASHLOG;
+   header[1] = idmanager_getMyID(ADDR_16B)->addr_16b[1];
+   header[2] = idmanager_getMyID(ADDR_16B)->addr_16b[0];
+   
+   return outputHdlcFrame(
+      SERIAL_LANE_DATA,
+      header,sizeof(header),
+      buffer,length,
+      NULL,0
+   );
+#else
+   return E_FAIL;
+#endif
 }
 
 owerror_t openserial_printInfo(uint8_t calling_component, uint8_t error_code,
@@ -279,6 +377,13 @@ void openserial_startInput() {
 #ifdef ENABLE_OPENSERIAL
    INTERRUPT_DECLARATION();
    
+#ifdef BOARD_UART_DMA_TX
+   if (uart_isWritingBuffer()==TRUE) {
+      // the uDMA is still sending output, the request frame would interleave
+      return;
+   }
+#endif
+   
    if (openserial_vars.inputBufFill>0) {
       openserial_printError(COMPONENT_OPENSERIAL,ERR_INPUTBUFFER_LENGTH,
                             (errorparameter_t)openserial_vars.inputBufFill,
@@ -303,13 +408,50 @@ void openserial_startInput() {
 #endif
 }
 
+/**
+\brief Start sending the output buffer over the UART.
+
+Called from the slot interrupt, so only kicks the UART. The status elements,
+and the next records of a flash log dump, are written by a task, and go out in
+this window if it is not over yet, or in the next one.
+*/
 void openserial_startOutput() {
 #ifdef ENABLE_OPENSERIAL
-   //schedule a task to get new status in the output buffer
-   uint8_t debugPrintCounter;
+   INTERRUPT_DECLARATION();
    
+   // schedule a task to get new status in the output buffer
+   DISABLE_INTERRUPTS();
+   if (openserial_vars.statusTaskPending==FALSE) {
+      openserial_vars.statusTaskPending = TRUE;
+      scheduler_push_task(openserial_statusTask,TASKPRIO_OPENSERIAL);
+   }
+   ENABLE_INTERRUPTS();
+   
+   // flush buffer
+   uart_clearTxInterrupts();
+   uart_clearRxInterrupts();          // clear possible pending interrupts
+   uart_enableInterrupts();           // Enable USCI_A1 TX & RX interrupt
+   DISABLE_INTERRUPTS();
+   openserial_vars.mode=MODE_OUTPUT;
+   if (outputSendNext()==FALSE) {
+      openserial_stop();
+   }
+   ENABLE_INTERRUPTS();
+#endif
+}
+
+/**
+\brief Write the next status element, and continue a flash log dump, into the
+   output buffer.
+
+Posted by openserial_startOutput(), runs outside of the slot interrupt.
+*/
+void openserial_statusTask() {
+   uint8_t debugPrintCounter;
    INTERRUPT_DECLARATION();
+   
    DISABLE_INTERRUPTS();
+   openserial_vars.statusTaskPending = FALSE;
    openserial_vars.debugPrintCounter = (openserial_vars.debugPrintCounter+1)%STATUS_MAX;
    debugPrintCounter = openserial_vars.debugPrintCounter;
    ENABLE_INTERRUPTS();
@@ -352,25 +494,22 @@ void openserial_startOutput() {
          if (debugPrint_neighbors()==TRUE) {
             break;
          }
+      case STATUS_SERIAL:
+         if (debugPrint_serial()==TRUE) {
+            break;
+         }
+      case STATUS_ENERGY:
+         if (debugPrint_energy()==TRUE) {
+            break;
+         }
       default:
          DISABLE_INTERRUPTS();
          openserial_vars.debugPrintCounter=0;
          ENABLE_INTERRUPTS();
    }
    
-   // flush buffer
-   uart_clearTxInterrupts();
-   uart_clearRxInterrupts();          // clear possible pending interrupts
-   uart_enableInterrupts();           // Enable USCI_A1 TX & RX interrupt
-   DISABLE_INTERRUPTS();
-   openserial_vars.mode=MODE_OUTPUT;
-   if (openserial_vars.outputBufFilled) {
-      uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
-   } else {
-      openserial_stop();
-   }
-   ENABLE_INTERRUPTS();
-#endif
+   // continue the dump of the flash log, if any
+   flashlog_dumpNext();
 }
 
 void openserial_stop() {
@@ -390,6 +529,7 @@ void openserial_stop() {
    
    DISABLE_INTERRUPTS();
    openserial_vars.mode=MODE_OFF;
+   openserial_vars.budgeted=FALSE;
    ENABLE_INTERRUPTS();
    //the inputBuffer has to be reset if it is not reset where the data is read.
    //or the function openserial_getInputBuffer is called (which resets the buffer)
@@ -412,6 +552,9 @@ void openserial_stop() {
              // golden image command
             openserial_goldenImageCommands();
             break;
+         case SERFRAME_PC2MOTE_FLASHLOG:
+            flashlog_startDump();
+            break;
          default:
             openserial_printError(COMPONENT_OPENSERIAL,ERR_UNSUPPORTED_COMMAND,
                                   (errorparameter_t)cmdByte,
@@ -431,6 +574,64 @@ void openserial_stop() {
 #endif
 }
 
+/**
+\brief Start a new slotframe of the serial bandwidth scheduler.
+
+Called by the MAC at the start of each slotframe. The statistics of the last
+slotframe are kept for debugPrint_serial(), and the UART budget is reset.
+
+\param[in] budgetTicks Number of ticks of the coming slotframe during which the
+   radio does not need the CPU, as computed by the MAC from the schedule.
+*/
+void openserial_newSlotframe(uint16_t budgetTicks) {
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   memcpy(&openserial_vars.lastStats,&openserial_vars.stats,sizeof(openserial_stats_t));
+   memset(&openserial_vars.stats,0,sizeof(openserial_stats_t));
+   openserial_vars.stats.budget         = openserial_ticksToBytes(budgetTicks);
+   openserial_vars.slotframeBytes       = openserial_vars.stats.budget;
+   openserial_vars.slotframeCounter     = (openserial_vars.slotframeCounter+1)%SERIAL_INPUT_PERIOD;
+   openserial_vars.inputWindowPending   = (openserial_vars.slotframeCounter==0);
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Open a serial window.
+
+Called by the MAC when its FSM goes idle, with the number of ticks until the
+radio needs the CPU again. The UART sends no more bytes than fit in that time,
+nor more than what is left of the slotframe budget. Once every
+SERIAL_INPUT_PERIOD slotframes, the first window is used to poll the PC for
+input instead.
+
+\param[in] ticks Number of ticks until the next active slot.
+*/
+void openserial_startWindow(uint16_t ticks) {
+#ifdef ENABLE_OPENSERIAL
+   bool inputWindow;
+   INTERRUPT_DECLARATION();
+   
+   if (ticks<=SERIAL_WINDOW_GUARD_TICKS) {
+      return;
+   }
+   
+   DISABLE_INTERRUPTS();
+   openserial_vars.budgeted             = TRUE;
+   openserial_vars.windowBytes          = openserial_ticksToBytes(ticks-SERIAL_WINDOW_GUARD_TICKS);
+   openserial_vars.stats.numWindows++;
+   inputWindow                          = openserial_vars.inputWindowPending;
+   openserial_vars.inputWindowPending   = FALSE;
+   ENABLE_INTERRUPTS();
+   
+   if (inputWindow==TRUE) {
+      openserial_startInput();
+   } else {
+      openserial_startOutput();
+   }
+#endif
+}
+
 void openserial_goldenImageCommands(void){
    uint8_t  input_buffer[7];
    uint8_t  numDataBytes;
@@ -494,61 +695,346 @@ status information about several modules in the OpenWSN stack.
 \returns TRUE if this function printed something, FALSE otherwise.
 */
 bool debugPrint_outBufferIndexes() {
-   uint16_t temp_buffer[2];
+   uint16_t temp_buffer[3*SERIAL_LANE_MAX];
+   uint8_t  lane;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
-   temp_buffer[0] = openserial_vars.outputBufIdxW;
-   temp_buffer[1] = openserial_vars.outputBufIdxR;
+   for (lane=0;lane<SERIAL_LANE_MAX;lane++) {
+      temp_buffer[3*lane+0] = openserial_vars.outputLanes[lane].idxW;
+      temp_buffer[3*lane+1] = openserial_vars.outputLanes[lane].idxR;
+      temp_buffer[3*lane+2] = openserial_vars.outputLanes[lane].numDropped;
+   }
    ENABLE_INTERRUPTS();
    openserial_printStatus(STATUS_OUTBUFFERINDEXES,(uint8_t*)temp_buffer,sizeof(temp_buffer));
    return TRUE;
 }
 
+/**
+\brief Trigger this module to print the serial throughput of the last slotframe.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_serial() {
+   openserial_stats_t temp;
+   INTERRUPT_DECLARATION();
+   
+   DISABLE_INTERRUPTS();
+   memcpy(&temp,&openserial_vars.lastStats,sizeof(openserial_stats_t));
+   ENABLE_INTERRUPTS();
+   
+   openserial_printStatus(STATUS_SERIAL,(uint8_t*)&temp,sizeof(openserial_stats_t));
+   return TRUE;
+}
+
 //=========================== private =========================================
 
 //===== hdlc (output)
 
 /**
-\brief Start an HDLC frame in the output buffer.
+\brief Write a complete HDLC frame into an output lane.
+
+The CRC and the escaped length of the frame are computed first, with interrupts
+enabled. The frame is then only copied into the lane if it fits entirely, so a
+full lane drops whole frames rather than overwriting the ones not sent yet.
+
+\param[in] lane          The lane to write to.
+\param[in] header        The first part of the frame.
+\param[in] headerLength  The number of bytes in header.
+\param[in] body          The second part of the frame, may be NULL.
+\param[in] bodyLength    The number of bytes in body.
+\param[in] trailer       The third part of the frame, may be NULL.
+\param[in] trailerLength The number of bytes in trailer.
+
+\returns E_SUCCESS if the frame was written, E_FAIL if it was dropped.
 */
-port_INLINE void outputHdlcOpen() {
-   // initialize the value of the CRC
-   openserial_vars.outputCrc                          = HDLC_CRCINIT;
+owerror_t outputHdlcFrame(
+      uint8_t          lane,
+      uint8_t*         header,
+      uint8_t          headerLength,
+      uint8_t*         body,
+      uint8_t          bodyLength,
+      uint8_t*         trailer,
+      uint8_t          trailerLength
+   ) {
+   openserial_lane_t* l;
+   uint16_t           crc;
+   uint8_t            crcBytes[2];
+   uint16_t           frameLength;
+   uint8_t            flag;
+   INTERRUPT_DECLARATION();
+   
+   // compute the CRC
+   crc          = HDLC_CRCINIT;
+   crc          = crcBuffer(crc,header,headerLength);
+   crc          = crcBuffer(crc,body,bodyLength);
+   crc          = crcBuffer(crc,trailer,trailerLength);
+   crc          = ~crc;
+   crcBytes[0]  = (crc>>0)&0xff;
+   crcBytes[1]  = (crc>>8)&0xff;
+   
+   // compute the length of the frame, once escaped and with both flags
+   frameLength  = 2;
+   frameLength += hdlcEscapedLength(header,headerLength);
+   frameLength += hdlcEscapedLength(body,bodyLength);
+   frameLength += hdlcEscapedLength(trailer,trailerLength);
+   frameLength += hdlcEscapedLength(crcBytes,sizeof(crcBytes));
+   
+   flag         = HDLC_FLAG;
+   l            = &openserial_vars.outputLanes[lane];
    
-   // write the opening HDLC flag
-   openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]     = HDLC_FLAG;
+   DISABLE_INTERRUPTS();
+   if (frameLength>(l->mask+1)-(uint16_t)(l->idxW-l->idxR)) {
+      // not enough room for the whole frame, drop it
+      l->numDropped++;
+      ENABLE_INTERRUPTS();
+      return E_FAIL;
+   }
+   outputBufCopy(lane,&flag,sizeof(flag));
+   outputHdlcWriteBuffer(lane,header,headerLength);
+   outputHdlcWriteBuffer(lane,body,bodyLength);
+   outputHdlcWriteBuffer(lane,trailer,trailerLength);
+   outputHdlcWriteBuffer(lane,crcBytes,sizeof(crcBytes));
+   outputBufCopy(lane,&flag,sizeof(flag));
+   ENABLE_INTERRUPTS();
+   
+   return E_SUCCESS;
 }
 /**
-\brief Add a byte to the outgoing HDLC frame being built.
+\brief Add a buffer to an output lane, HDLC-escaping it.
+
+The runs of bytes which do not need escaping are copied into the lane in one go.
 */
-port_INLINE void outputHdlcWrite(uint8_t b) {
+port_INLINE void outputHdlcWriteBuffer(uint8_t lane, uint8_t* buffer, uint8_t length) {
+   uint8_t run;
+   uint8_t escaped[2];
    
-   // iterate through CRC calculator
-   openserial_vars.outputCrc = crcIteration(openserial_vars.outputCrc,b);
+   while (length>0) {
+      // copy the bytes up to the next one to escape
+      run = hdlcEscapeScan(buffer,length);
+      outputBufCopy(lane,buffer,run);
+      buffer += run;
+      length -= run;
+      
+      // escape that byte
+      if (length>0) {
+         escaped[0]  = HDLC_ESCAPE;
+         escaped[1]  = (*buffer)^HDLC_ESCAPE_MASK;
+         outputBufCopy(lane,escaped,sizeof(escaped));
+         buffer++;
+         length--;
+      }
+   }
+}
+/**
+\brief Copy bytes into an output lane, wrapping around its end.
+*/
+port_INLINE void outputBufCopy(uint8_t lane, uint8_t* buffer, uint8_t length) {
+   openserial_lane_t* l;
+   uint16_t           pos;
+   uint16_t           untilEnd;
    
-   // add byte to buffer
-   if (b==HDLC_FLAG || b==HDLC_ESCAPE) {
-      openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]  = HDLC_ESCAPE;
-      b                                               = b^HDLC_ESCAPE_MASK;
+   l        = &openserial_vars.outputLanes[lane];
+   pos      = l->idxW & l->mask;
+   untilEnd = l->mask+1-pos;
+   if (length<=untilEnd) {
+      memcpy(&openserial_vars.outputBuf[l->base+pos],buffer,length);
+   } else {
+      memcpy(&openserial_vars.outputBuf[l->base+pos],buffer,untilEnd);
+      memcpy(&openserial_vars.outputBuf[l->base],&buffer[untilEnd],length-untilEnd);
    }
-   openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]     = b;
+   l->idxW += length;
+}
+
+/**
+\brief Get the next byte the UART should send.
+
+The lane is only changed between frames, picking the highest-priority lane
+which holds a frame.
+
+\param[out] b The byte to send.
+
+\returns TRUE if there is a byte to send, FALSE if all lanes are empty.
+*/
+port_INLINE bool outputBufNextByte(uint8_t* b) {
+   openserial_lane_t* l;
+   uint8_t            lane;
    
+   if (openserial_vars.outputInFrame==FALSE) {
+      // between frames, pick the highest-priority lane with something to send
+      for (lane=0;lane<SERIAL_LANE_MAX;lane++) {
+         if (openserial_vars.outputLanes[lane].idxW!=openserial_vars.outputLanes[lane].idxR) {
+            break;
+         }
+      }
+      if (lane==SERIAL_LANE_MAX) {
+         return FALSE;
+      }
+      openserial_vars.outputLaneR = lane;
+   }
+   
+   l  = &openserial_vars.outputLanes[openserial_vars.outputLaneR];
+   *b = openserial_vars.outputBuf[l->base+(l->idxR & l->mask)];
+   l->idxR++;
+   
+   // a frame starts and ends with the only unescaped flags
+   if (*b==HDLC_FLAG) {
+      openserial_vars.outputInFrame = !openserial_vars.outputInFrame;
+   }
+   
+   return TRUE;
 }
+
+#ifdef BOARD_UART_DMA_TX
 /**
-\brief Finalize the outgoing HDLC frame.
+\brief Get the next contiguous segment of output bytes the UART should send.
+
+Like outputBufNextByte(), the lane is only changed between frames, so the
+segment ends after the flag closing the current frame. It also ends where the
+lane wraps around. The bytes stay in the lane until outputSendNext() sees the
+uDMA is done with them.
+
+\param[out] segment   Start of the segment, in outputBuf.
+\param[in]  maxLength Maximum number of bytes in the segment.
+
+\returns The number of bytes in the segment, 0 if all lanes are empty.
 */
-port_INLINE void outputHdlcClose() {
-   uint16_t   finalCrc;
-    
-   // finalize the calculation of the CRC
-   finalCrc   = ~openserial_vars.outputCrc;
+port_INLINE uint16_t outputBufNextSegment(uint8_t** segment, uint16_t maxLength) {
+   openserial_lane_t* l;
+   uint8_t            lane;
+   uint16_t           start;
+   uint16_t           length;
+   uint8_t            skip;
+   uint8_t*           flag;
+   
+   if (openserial_vars.outputInFrame==FALSE) {
+      // between frames, pick the highest-priority lane with something to send
+      for (lane=0;lane<SERIAL_LANE_MAX;lane++) {
+         if (openserial_vars.outputLanes[lane].idxW!=openserial_vars.outputLanes[lane].idxR) {
+            break;
+         }
+      }
+      if (lane==SERIAL_LANE_MAX) {
+         return 0;
+      }
+      openserial_vars.outputLaneR = lane;
+   }
    
-   // write the CRC value
-   outputHdlcWrite((finalCrc>>0)&0xff);
-   outputHdlcWrite((finalCrc>>8)&0xff);
+   l        = &openserial_vars.outputLanes[openserial_vars.outputLaneR];
+   start    = l->idxR & l->mask;
+   length   = l->idxW-l->idxR;
+   if (length>l->mask+1-start) {
+      length = l->mask+1-start;
+   }
+   if (length>maxLength) {
+      length = maxLength;
+   }
+   *segment = &openserial_vars.outputBuf[l->base+start];
+   
+   // between frames, the segment starts with the opening flag
+   skip     = (openserial_vars.outputInFrame==FALSE) ? 1 : 0;
+   flag     = memchr(*segment+skip,HDLC_FLAG,length-skip);
+   if (flag!=NULL) {
+      length = flag-*segment+1;
+      openserial_vars.outputInFrame = FALSE;
+   } else {
+      openserial_vars.outputInFrame = TRUE;
+   }
    
-   // write the closing HDLC flag
-   openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]   = HDLC_FLAG;
+   openserial_vars.outputSegmentLength = length;
+   return length;
+}
+#endif
+
+/**
+\brief Check whether all output lanes are empty.
+*/
+port_INLINE bool outputBufIsEmpty() {
+   uint8_t lane;
+   
+   for (lane=0;lane<SERIAL_LANE_MAX;lane++) {
+      if (openserial_vars.outputLanes[lane].idxW!=openserial_vars.outputLanes[lane].idxR) {
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/**
+\brief Hand the next output bytes to the UART, if the bandwidth budget allows.
+
+On boards with BOARD_UART_DMA_TX, the UART gets a contiguous segment of a lane
+which the uDMA sends with a single interrupt at its end. Other boards get one
+byte per interrupt. Once the window or the slotframe budget is used up, the
+UART stays quiet until the MAC opens the next window; a frame cut in the
+middle resumes there.
+
+\note Call with interrupts disabled.
+
+\returns TRUE if the UART is sending, FALSE otherwise.
+*/
+port_INLINE bool outputSendNext() {
+   uint16_t maxLength;
+   uint16_t length;
+#ifdef BOARD_UART_DMA_TX
+   uint8_t* segment;
+   
+   if (openserial_vars.outputSegmentLength>0) {
+      if (uart_isWritingBuffer()==TRUE) {
+         // the end of the segment still calls back here
+         return TRUE;
+      }
+      // the segment is out, free its room in the lane
+      openserial_vars.outputLanes[openserial_vars.outputLaneR].idxR += openserial_vars.outputSegmentLength;
+      openserial_vars.outputSegmentLength = 0;
+   }
+#else
+   uint8_t  b;
+#endif
+   
+   maxLength = 0xffff;
+   if (openserial_vars.budgeted==TRUE) {
+      maxLength = openserial_vars.windowBytes;
+      if (maxLength>openserial_vars.slotframeBytes) {
+         maxLength = openserial_vars.slotframeBytes;
+      }
+      if (maxLength==0) {
+         if (outputBufIsEmpty()==FALSE) {
+            openserial_vars.stats.numBudgetExhausted++;
+         }
+         openserial_vars.mode = MODE_OFF;
+         return FALSE;
+      }
+   }
+   
+#ifdef BOARD_UART_DMA_TX
+   length = outputBufNextSegment(&segment,maxLength);
+   if (length==0) {
+      return FALSE;
+   }
+   uart_writeBuffer(segment,length);
+#else
+   if (outputBufNextByte(&b)==FALSE) {
+      return FALSE;
+   }
+   uart_writeByte(b);
+   length = 1;
+#endif
+   
+   openserial_vars.stats.numBytesOut += length;
+   if (openserial_vars.budgeted==TRUE) {
+      openserial_vars.windowBytes      -= length;
+      openserial_vars.slotframeBytes   -= length;
+   }
+   return TRUE;
+}
+
+//===== bandwidth
+
+/**
+\brief Convert a number of 32kHz ticks into the number of bytes the UART sends in that time.
+*/
+port_INLINE uint16_t openserial_ticksToBytes(uint16_t ticks) {
+   return (uint16_t)(((uint32_t)ticks*SERIAL_BYTES_PER_1024_TICKS)>>10);
 }
 
 //===== hdlc (input)
@@ -614,12 +1100,7 @@ void isr_openserial_tx() {
          }
          break;
       case MODE_OUTPUT:
-         if (openserial_vars.outputBufIdxW==openserial_vars.outputBufIdxR) {
-            openserial_vars.outputBufFilled = FALSE;
-         }
-         if (openserial_vars.outputBufFilled) {
-            uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
-         }
+         outputSendNext();
          break;
       case MODE_OFF:
       default:
@@ -639,6 +1120,7 @@ void isr_openserial_rx() {
    
    // read byte just received
    rxbyte = uart_readByte();
+   openserial_vars.stats.numBytesIn++;
    //keep lenght
    inputBufFill=openserial_vars.inputBufFill;
    
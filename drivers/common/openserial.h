@@ -19,12 +19,21 @@
 //=========================== define ==========================================
 
 /**
-\brief Number of bytes of the serial output buffer, in bytes.
+\brief Number of bytes of each output lane, in bytes.
 
-\warning should be exactly 256 so wrap-around on the index does not require
-         the use of a slow modulo operator.
+Frames are written to one of several lanes depending on their type, so a burst
+of status frames cannot push out the error frames. The UART sends the frames of
+the lowest-numbered lane first.
+
+\warning each should be a power of 2, so wrap-around on the index does not
+         require the use of a slow modulo operator.
 */
-#define SERIAL_OUTPUT_BUFFER_SIZE 256 // leave at 256!
+#define SERIAL_OUTPUT_LANE_ERROR_SIZE   128 // info, error and critical frames
+#define SERIAL_OUTPUT_LANE_DATA_SIZE    128 // data and sniffed packet frames
+#define SERIAL_OUTPUT_LANE_STATUS_SIZE  256 // status frames
+
+/// Number of bytes of the serial output buffer, in bytes.
+#define SERIAL_OUTPUT_BUFFER_SIZE (SERIAL_OUTPUT_LANE_ERROR_SIZE+SERIAL_OUTPUT_LANE_DATA_SIZE+SERIAL_OUTPUT_LANE_STATUS_SIZE)
 
 /**
 \brief Number of bytes of the serial input buffer, in bytes.
@@ -34,6 +43,29 @@
 */
 #define SERIAL_INPUT_BUFFER_SIZE  200
 
+/**
+\brief Number of bytes the UART transfers per 1024 ticks of the 32kHz timer.
+
+At 115200 baud with 8N1 framing the UART transfers 11520 bytes per second, i.e.
+360 bytes per 1024 ticks. The bandwidth scheduler converts the idle time the
+MAC hands it into a number of bytes using this rate.
+*/
+#define SERIAL_BYTES_PER_1024_TICKS     360
+
+/// Ticks kept free at the end of a serial window, so the UART is quiet when the radio needs the CPU.
+#define SERIAL_WINDOW_GUARD_TICKS       5
+
+/// Once every SERIAL_INPUT_PERIOD slotframes, the first serial window is used for input.
+#define SERIAL_INPUT_PERIOD             4
+
+/// Output lanes, in decreasing order of priority.
+enum {
+   SERIAL_LANE_ERROR  = 0, ///< Info, error and critical frames.
+   SERIAL_LANE_DATA   = 1, ///< Data and sniffed packet frames.
+   SERIAL_LANE_STATUS = 2, ///< Status frames.
+   SERIAL_LANE_MAX    = 3
+};
+
 /// Modes of the openserial module.
 enum {
    MODE_OFF    = 0, ///< The module is off, no serial activity.
@@ -49,12 +81,15 @@ enum {
 #define SERFRAME_MOTE2PC_CRITICAL           ((uint8_t)'C')
 #define SERFRAME_MOTE2PC_REQUEST            ((uint8_t)'R')
 #define SERFRAME_MOTE2PC_SNIFFED_PACKET     ((uint8_t)'P')
+#define SERFRAME_MOTE2PC_TELEMETRY          ((uint8_t)'T')
+#define SERFRAME_MOTE2PC_FLASHLOG           ((uint8_t)'L')
 
 // frames sent PC->mote
 #define SERFRAME_PC2MOTE_SETROOT            ((uint8_t)'R')
 #define SERFRAME_PC2MOTE_DATA               ((uint8_t)'D')
 #define SERFRAME_PC2MOTE_TRIGGERSERIALECHO  ((uint8_t)'S')
 #define SERFRAME_PC2MOTE_COMMAND_GD         ((uint8_t)'G')
+#define SERFRAME_PC2MOTE_FLASHLOG           ((uint8_t)'L')
 
 //=========================== typedef =========================================
 
@@ -72,12 +107,31 @@ enum {
    COMMAND_MAX                   = 10,
 };
 
+BEGIN_PACK
+typedef struct {
+   uint16_t   budget;             // bytes the schedule leaves for the UART in a slotframe
+   uint16_t   numBytesOut;        // bytes sent
+   uint16_t   numBytesIn;         // bytes received
+   uint8_t    numWindows;         // serial windows opened by the MAC
+   uint8_t    numBudgetExhausted; // windows which ended with data left in the output lanes
+} openserial_stats_t;
+END_PACK
+
+typedef struct {
+   uint16_t   base;         // offset of the lane in outputBuf
+   uint16_t   mask;         // size of the lane minus 1
+   uint16_t   idxW;         // write index, wraps around at 65536, not at the lane size
+   uint16_t   idxR;         // read index, wraps around at 65536, not at the lane size
+   uint16_t   numDropped;   // number of frames dropped because the lane was full
+} openserial_lane_t;
+
 //=========================== module variables ================================
 
 typedef struct {
    // admin
    uint8_t    mode;
    uint8_t    debugPrintCounter;
+   bool       statusTaskPending; // has openserial_startOutput() posted a task which did not run yet?
    // input
    uint8_t    reqFrame[1+1+2+1]; // flag (1B), command (2B), CRC (2B), flag (1B)
    uint8_t    reqFrameIdx;
@@ -88,11 +142,21 @@ typedef struct {
    uint8_t    inputBufFill;
    uint8_t    inputBuf[SERIAL_INPUT_BUFFER_SIZE];
    // output
-   bool       outputBufFilled;
-   uint16_t   outputCrc;
-   uint8_t    outputBufIdxW;
-   uint8_t    outputBufIdxR;
+   uint8_t    outputLaneR;  // lane the UART is sending from
+   bool       outputInFrame;// has the UART sent the opening flag of a frame, but not its closing flag?
+   openserial_lane_t outputLanes[SERIAL_LANE_MAX];
+#ifdef BOARD_UART_DMA_TX
+   uint16_t   outputSegmentLength;// bytes handed to the uDMA, still counted in their lane
+#endif
    uint8_t    outputBuf[SERIAL_OUTPUT_BUFFER_SIZE];
+   // bandwidth
+   bool       budgeted;           // is the UART limited to the current window?
+   bool       inputWindowPending; // is the next window of this slotframe an input window?
+   uint8_t    slotframeCounter;
+   uint16_t   windowBytes;        // bytes the UART can still send in the current window
+   uint16_t   slotframeBytes;     // bytes the UART can still send in the current slotframe
+   openserial_stats_t stats;      // statistics of the current slotframe
+   openserial_stats_t lastStats;  // statistics of the last complete slotframe
 } openserial_vars_t;
 
 //=========================== prototypes ======================================
@@ -110,12 +174,16 @@ owerror_t openserial_printCritical(uint8_t calling_component, uint8_t error_code
                               errorparameter_t arg2);
 owerror_t openserial_printData(uint8_t* buffer, uint8_t length);
 owerror_t openserial_printPacket(uint8_t* buffer, uint8_t length, uint8_t channel);
+owerror_t openserial_printFlashlog(uint8_t* buffer, uint8_t length);
 uint8_t openserial_getNumDataBytes(void);
 uint8_t openserial_getInputBuffer(uint8_t* bufferToWrite, uint8_t maxNumBytes);
 void    openserial_startInput(void);
 void    openserial_startOutput(void);
 void    openserial_stop(void);
+void    openserial_newSlotframe(uint16_t budgetTicks);
+void    openserial_startWindow(uint16_t ticks);
 bool    debugPrint_outBufferIndexes(void);
+bool    debugPrint_serial(void);
 void    openserial_echo(uint8_t* but, uint8_t bufLen);
 
 // interrupt handlers
@@ -4,6 +4,19 @@
 This driver uses a single hardware timer, which it virtualizes to support
 at most MAX_NUM_TIMERS timers.
 
+Running timers are kept in a doubly-linked list sorted by expiry time. Each
+timer only stores the number of ticks between the expiry of the timer before it
+and its own (a "delta list"), so the hardware timer is always scheduled for the
+head of the list, and the timers expiring at the same time sit next to each
+other. Stopping a timer and handling an expiry is O(1); starting a timer walks
+the list to find its position.
+
+A timer can be given some slack, i.e. the number of ticks it can fire late by.
+The hardware timer is then scheduled for the earliest deadline-plus-slack, and
+the MAC calls opentimers_fireDueTimers() when it wakes up for a new slot, so
+timers with slack expire on a wake-up which happens anyway rather than on
+their own.
+
 \author Xavi Vilajosana <xvilajosana@eecs.berkeley.edu>, March 2012.
  */
 
@@ -21,7 +34,15 @@ opentimers_vars_t opentimers_vars;
 
 //=========================== prototypes ======================================
 
-void opentimers_timer_callback(void);
+void     opentimers_timer_callback(void);
+uint32_t opentimers_toTicks(uint32_t duration, time_type_t timetype);
+void     opentimers_insert(opentimer_id_t id, uint32_t ticks);
+void     opentimers_remove(opentimer_id_t id);
+void     opentimers_advance(uint32_t ticks);
+void     opentimers_rebase(void);
+void     opentimers_expire(void);
+void     opentimers_schedule(bool rebase);
+uint32_t opentimers_wakeupTicks(void);
 
 //=========================== public ==========================================
 
@@ -34,14 +55,21 @@ void opentimers_init(){
    uint8_t i;
 
    // initialize local variables
-   opentimers_vars.running=FALSE;
+   opentimers_vars.running        = FALSE;
+   opentimers_vars.inCallback     = FALSE;
+   opentimers_vars.head           = TIMER_ID_NONE;
+   opentimers_vars.currentTimeout = 0;
+   opentimers_vars.lastCompare    = 0;
    for (i=0;i<MAX_NUM_TIMERS;i++) {
       opentimers_vars.timersBuf[i].period_ticks       = 0;
-      opentimers_vars.timersBuf[i].ticks_remaining    = 0;
+      opentimers_vars.timersBuf[i].delta_ticks        = 0;
+      opentimers_vars.timersBuf[i].slack_ticks        = 0;
+      opentimers_vars.timersBuf[i].overdue_ticks      = 0;
       opentimers_vars.timersBuf[i].type               = TIMER_ONESHOT;
       opentimers_vars.timersBuf[i].isrunning          = FALSE;
       opentimers_vars.timersBuf[i].callback           = NULL;
-      opentimers_vars.timersBuf[i].hasExpired         = FALSE;
+      opentimers_vars.timersBuf[i].prev               = TIMER_ID_NONE;
+      opentimers_vars.timersBuf[i].next               = TIMER_ID_NONE;
    }
 
    // set callback for bsp_timers module
@@ -52,10 +80,10 @@ void opentimers_init(){
 \brief Start a timer.
 
 The timer works as follows:
-- currentTimeout is the number of ticks before the next timer expires.
-- if a new timer is inserted, we check that it is not earlier than the soonest
-- if it is earliest, replace it
-- if not, insert it in the list
+- the ticks which elapsed since the hardware timer was last scheduled are
+  removed from the running timers
+- the new timer is inserted in the sorted list of running timers
+- if it is earliest, the hardware timer is re-scheduled for it
 
 \param duration Number milli-seconds after which the timer will fire.
 \param type     Type of timer:
@@ -71,293 +99,440 @@ The timer works as follows:
 \returns TOO_MANY_TIMERS_ERROR if the timer could NOT be started.
  */
 opentimer_id_t opentimers_start(uint32_t duration, timer_type_t type, time_type_t timetype, opentimers_cbt callback) {
-
    uint8_t  id;
+   INTERRUPT_DECLARATION();
+
+   DISABLE_INTERRUPTS();
 
    // find an unused timer
    for (id=0; id<MAX_NUM_TIMERS && opentimers_vars.timersBuf[id].isrunning==TRUE; id++);
 
-   if (id<MAX_NUM_TIMERS) {
-      // we found an unused timer
+   if (id>=MAX_NUM_TIMERS) {
+      ENABLE_INTERRUPTS();
+      return TOO_MANY_TIMERS_ERROR;
+   }
 
-      // register the timer
-      if (timetype==TIME_MS) {
-         opentimers_vars.timersBuf[id].period_ticks      = duration*PORT_TICS_PER_MS;
-         opentimers_vars.timersBuf[id].wraps_remaining   = (duration*PORT_TICS_PER_MS/MAX_TICKS_IN_SINGLE_CLOCK);//65535=maxValue of uint16_t
-      } else if (timetype==TIME_TICS) {
-         opentimers_vars.timersBuf[id].period_ticks      = duration;
-         opentimers_vars.timersBuf[id].wraps_remaining   = (duration/MAX_TICKS_IN_SINGLE_CLOCK);//65535=maxValue of uint16_t  
-      } else {
-         while (1); //error
-      }
-      //if the number of ticks falls below a 16bit value, use it, otherwise set to max 16bit value
-      if(opentimers_vars.timersBuf[id].wraps_remaining==0){
-         if (timetype==TIME_MS){ 
-            opentimers_vars.timersBuf[id].ticks_remaining   = duration*PORT_TICS_PER_MS;
-         } else if (timetype==TIME_TICS) {
-            opentimers_vars.timersBuf[id].ticks_remaining   = duration;
-         } else {
-            // this should never happpen!
-   
-            // we can not print from within the drivers. Instead:
-            // blink the error LED
-            leds_error_blink();
-            // reset the board
-            board_reset();
-         }
-      }else{
-         opentimers_vars.timersBuf[id].ticks_remaining = MAX_TICKS_IN_SINGLE_CLOCK;
-      }                                                   
-      opentimers_vars.timersBuf[id].type              = type;
-      opentimers_vars.timersBuf[id].isrunning         = TRUE;
-      opentimers_vars.timersBuf[id].callback          = callback;
-      opentimers_vars.timersBuf[id].hasExpired        = FALSE;
-
-      // re-schedule the running timer, if needed
-      if (
-            (opentimers_vars.running==FALSE)
-            ||
-            (opentimers_vars.timersBuf[id].ticks_remaining < opentimers_vars.currentTimeout)
-      ) {  
-         opentimers_vars.currentTimeout            = opentimers_vars.timersBuf[id].ticks_remaining;
-         if (opentimers_vars.running==FALSE) {
-            bsp_timer_reset();
-         }
-         bsp_timer_scheduleIn(opentimers_vars.timersBuf[id].ticks_remaining);
-      }
+   // register the timer
+   opentimers_vars.timersBuf[id].period_ticks      = opentimers_toTicks(duration,timetype);
+   opentimers_vars.timersBuf[id].slack_ticks       = 0;
+   opentimers_vars.timersBuf[id].type              = type;
+   opentimers_vars.timersBuf[id].isrunning         = TRUE;
+   opentimers_vars.timersBuf[id].callback          = callback;
 
-      opentimers_vars.running                         = TRUE;
+   // insert it, and re-schedule the hardware timer if needed
+   opentimers_rebase();
+   opentimers_insert(id,opentimers_vars.timersBuf[id].period_ticks);
+   opentimers_schedule(TRUE);
 
-   } else {
-      return TOO_MANY_TIMERS_ERROR;
-   }
+   ENABLE_INTERRUPTS();
 
    return id;
 }
 
 /**
 \brief Replace the period of a running timer.
+
+The timer restarts counting its new period from now.
  */
 void  opentimers_setPeriod(opentimer_id_t id,time_type_t timetype,uint32_t newDuration) {
-   if        (timetype==TIME_MS) {
-      opentimers_vars.timersBuf[id].period_ticks      = newDuration*PORT_TICS_PER_MS;
-      opentimers_vars.timersBuf[id].wraps_remaining   = (newDuration*PORT_TICS_PER_MS/MAX_TICKS_IN_SINGLE_CLOCK);//65535=maxValue of uint16_t
-   } else if (timetype==TIME_TICS) {
-      opentimers_vars.timersBuf[id].period_ticks      = newDuration;
-      opentimers_vars.timersBuf[id].wraps_remaining   = (newDuration/MAX_TICKS_IN_SINGLE_CLOCK);//65535=maxValue of uint16_t
-   } else {
-      // this should never happpen!
-      
-      // we can not print from within the drivers. Instead:
-      // blink the error LED
-      leds_error_blink();
-      // reset the board
-      board_reset();
-   }
-   if(opentimers_vars.timersBuf[id].wraps_remaining==0) {
-      if        (timetype==TIME_MS){
-         opentimers_vars.timersBuf[id].ticks_remaining   = newDuration*PORT_TICS_PER_MS;
-      } else if (timetype==TIME_TICS){
-         opentimers_vars.timersBuf[id].ticks_remaining   = newDuration;
-      }
-   } else {
-      opentimers_vars.timersBuf[id].ticks_remaining = MAX_TICKS_IN_SINGLE_CLOCK;
+   INTERRUPT_DECLARATION();
+
+   DISABLE_INTERRUPTS();
+
+   opentimers_vars.timersBuf[id].period_ticks = opentimers_toTicks(newDuration,timetype);
+
+   if (opentimers_vars.timersBuf[id].isrunning==TRUE) {
+      opentimers_remove(id);
+      opentimers_rebase();
+      opentimers_insert(id,opentimers_vars.timersBuf[id].period_ticks);
+      opentimers_schedule(TRUE);
    }
+
+   ENABLE_INTERRUPTS();
 }
 
 /**
 \brief Stop a running timer.
 
-Sets the timer to "not running". the system recovers even if this was the next
-timer to expire.
+Sets the timer to "not running". The hardware timer is not touched: if this was
+the next timer to expire, the system wakes up, finds no expired timer and
+recovers.
  */
 void opentimers_stop(opentimer_id_t id) {
-   opentimers_vars.timersBuf[id].isrunning=FALSE;
+   INTERRUPT_DECLARATION();
+
+   DISABLE_INTERRUPTS();
+
+   if (opentimers_vars.timersBuf[id].isrunning==TRUE) {
+      opentimers_remove(id);
+      opentimers_vars.timersBuf[id].isrunning = FALSE;
+   }
+
+   ENABLE_INTERRUPTS();
 }
 
 /**
 \brief Restart a stop timer.
 
-Sets the timer to " running".
+Sets the timer to "running", and has it count its full period from now.
  */
 void opentimers_restart(opentimer_id_t id) {
-   opentimers_vars.timersBuf[id].isrunning=TRUE;
+   INTERRUPT_DECLARATION();
+
+   DISABLE_INTERRUPTS();
+
+   if (opentimers_vars.timersBuf[id].isrunning==FALSE) {
+      opentimers_vars.timersBuf[id].isrunning = TRUE;
+      opentimers_rebase();
+      opentimers_insert(id,opentimers_vars.timersBuf[id].period_ticks);
+      opentimers_schedule(TRUE);
+   }
+
+   ENABLE_INTERRUPTS();
 }
 
+/**
+\brief Allow a running timer to fire late.
+
+The timer still never fires before its deadline. It fires at the first
+opentimers_fireDueTimers() call after its deadline, or at the latest
+<tt>slack</tt> after its deadline. The slack applies until the timer is
+started again. A periodic timer counts its next period from the moment it
+fires, so its period stretches by at most the slack.
 
-//=========================== private =========================================
+\param id       The timer.
+\param timetype Units of the <tt>slack</tt>.
+\param slack    How late the timer can fire.
+ */
+void opentimers_setSlack(opentimer_id_t id, time_type_t timetype, uint32_t slack) {
+   INTERRUPT_DECLARATION();
+
+   DISABLE_INTERRUPTS();
+
+   opentimers_vars.timersBuf[id].slack_ticks = opentimers_toTicks(slack,timetype);
+
+   if (opentimers_vars.timersBuf[id].isrunning==TRUE) {
+      opentimers_rebase();
+      opentimers_schedule(TRUE);
+   }
+
+   ENABLE_INTERRUPTS();
+}
 
 /**
-\brief Function called when the hardware timer expires.
+\brief Fire the timers whose deadline has passed.
 
-Executed in interrupt mode.
+Called by the MAC at the start of each slot, when the CPU is awake anyway, so
+timers with slack do not need a wake-up of their own. Executed in interrupt
+mode.
 
-This function maps the expiration event to possibly multiple timers, calls the
-corresponding callback(s), and restarts the hardware timer with the next timer
-to expire.
+The compare event of the head of the list may have happened already, and wait
+for interrupts to be enabled. Re-scheduling the hardware timer resets it, which
+drops that compare event, so opentimers_timer_callback() does not count it.
  */
-void opentimers_timer_callback() {
-   
-   opentimer_id_t   id;
-   PORT_TIMER_WIDTH min_timeout;
-   bool             found;
-    
-   // step 1. Identify expired timers
-   for(id=0; id<MAX_NUM_TIMERS; id++) {
-      if (opentimers_vars.timersBuf[id].isrunning==TRUE) {
-
-         if(opentimers_vars.currentTimeout >= opentimers_vars.timersBuf[id].ticks_remaining) {
-            // this timer has expired
-            //check to see if we have completed the whole timer, or we're just wrapping around the max 16bit value
-            if(opentimers_vars.timersBuf[id].wraps_remaining == 0){
-               // declare as so
-               opentimers_vars.timersBuf[id].hasExpired  = TRUE;
-            }else{
-               opentimers_vars.timersBuf[id].wraps_remaining--;
-               if(opentimers_vars.timersBuf[id].wraps_remaining == 0){
-                  //if we have fully wrapped around, then set the remainring ticks to the modulus of the total ticks and the max clock value
-                  opentimers_vars.timersBuf[id].ticks_remaining = (opentimers_vars.timersBuf[id].period_ticks) % MAX_TICKS_IN_SINGLE_CLOCK;
-               }else{
-                  opentimers_vars.timersBuf[id].ticks_remaining = MAX_TICKS_IN_SINGLE_CLOCK;
-               }
-            }
-         } else {
-            // this timer is not expired
+void opentimers_fireDueTimers(void) {
+   INTERRUPT_DECLARATION();
+
+   DISABLE_INTERRUPTS();
 
-            // update its counter
-            opentimers_vars.timersBuf[id].ticks_remaining -= opentimers_vars.currentTimeout;
-         }   
+   if (opentimers_vars.running==TRUE) {
+      opentimers_rebase();
+      if (
+            opentimers_vars.head!=TIMER_ID_NONE &&
+            opentimers_vars.timersBuf[opentimers_vars.head].delta_ticks==0
+         ) {
+         opentimers_expire();
+         opentimers_schedule(TRUE);
       }
    }
 
-   // step 2. call callbacks of expired timers
-   for(id=0; id<MAX_NUM_TIMERS; id++) {
-      if (opentimers_vars.timersBuf[id].hasExpired==TRUE){
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Account for time during which the hardware timer was stopped.
 
-         // call the callback
-         opentimers_vars.timersBuf[id].callback(id);
-         opentimers_vars.timersBuf[id].hasExpired     = FALSE;
+Called by boards whose timer does not run while sleeping. Timers which would
+have expired during the sleep period are fired now.
 
-         // reload the timer, if applicable
-         if (opentimers_vars.timersBuf[id].type==TIMER_PERIODIC) {
-            opentimers_vars.timersBuf[id].wraps_remaining   = (opentimers_vars.timersBuf[id].period_ticks/MAX_TICKS_IN_SINGLE_CLOCK);//65535=maxValue of uint16_t
-            //if the number of ticks falls below a 16bit value, use it, otherwise set to max 16bit value
-            if(opentimers_vars.timersBuf[id].wraps_remaining==0)                                                
-               opentimers_vars.timersBuf[id].ticks_remaining   = opentimers_vars.timersBuf[id].period_ticks;
-            else
-               opentimers_vars.timersBuf[id].ticks_remaining = MAX_TICKS_IN_SINGLE_CLOCK;
+\param sleepTime Number of ticks spent sleeping.
+ */
+void opentimers_sleepTimeCompesation(uint16_t sleepTime) {
+   INTERRUPT_DECLARATION();
 
-         } else {
-            opentimers_vars.timersBuf[id].isrunning   = FALSE;
-         }
-      }
+   DISABLE_INTERRUPTS();
 
+   opentimers_rebase();
+   opentimers_advance(sleepTime);
+   opentimers_expire();
+   opentimers_schedule(TRUE);
+
+   ENABLE_INTERRUPTS();
+}
+
+//=========================== private =========================================
+
+/**
+\brief Convert a duration to a number of ticks.
+ */
+uint32_t opentimers_toTicks(uint32_t duration, time_type_t timetype) {
+   if        (timetype==TIME_MS) {
+      return duration*PORT_TICS_PER_MS;
+   } else if (timetype==TIME_TICS) {
+      return duration;
    }
 
-   // step 3. find the minimum remaining timeout among running timers
-   found = FALSE;
-   for(id=0;id<MAX_NUM_TIMERS;id++) {
-      if (
-            opentimers_vars.timersBuf[id].isrunning==TRUE &&
-            (
-                  found==FALSE
-                  ||
-                  opentimers_vars.timersBuf[id].ticks_remaining < min_timeout
-            )
-      ) {
-         min_timeout    = opentimers_vars.timersBuf[id].ticks_remaining;
-         found          = TRUE;
-      }
+   // this should never happpen!
+
+   // we can not print from within the drivers. Instead:
+   // blink the error LED
+   leds_error_blink();
+   // reset the board
+   board_reset();
+
+   return 0;
+}
+
+/**
+\brief Insert a timer in the list of running timers.
+
+\param id    The timer to insert.
+\param ticks Number of ticks after opentimers_vars.lastCompare at which the
+   timer expires.
+ */
+void opentimers_insert(opentimer_id_t id, uint32_t ticks) {
+   opentimer_id_t prev;
+   opentimer_id_t next;
+
+   // find the position, timers expiring at the same time keep their order
+   prev = TIMER_ID_NONE;
+   next = opentimers_vars.head;
+   while (next!=TIMER_ID_NONE && ticks>=opentimers_vars.timersBuf[next].delta_ticks) {
+      ticks -= opentimers_vars.timersBuf[next].delta_ticks;
+      prev   = next;
+      next   = opentimers_vars.timersBuf[next].next;
    }
 
-   // step 4. schedule next timeout
-   if (found==TRUE) {
-      // at least one timer pending
-      opentimers_vars.currentTimeout = min_timeout;
-      bsp_timer_scheduleIn(opentimers_vars.currentTimeout);
+   // link it
+   opentimers_vars.timersBuf[id].delta_ticks   = ticks;
+   opentimers_vars.timersBuf[id].overdue_ticks = 0;
+   opentimers_vars.timersBuf[id].prev        = prev;
+   opentimers_vars.timersBuf[id].next        = next;
+   if (prev==TIMER_ID_NONE) {
+      opentimers_vars.head                   = id;
    } else {
-      // no more timers pending
-      opentimers_vars.running = FALSE;
+      opentimers_vars.timersBuf[prev].next   = id;
+   }
+   if (next!=TIMER_ID_NONE) {
+      opentimers_vars.timersBuf[next].prev         = id;
+      opentimers_vars.timersBuf[next].delta_ticks -= ticks;
    }
 }
 
-void opentimers_sleepTimeCompesation(uint16_t sleepTime)
-{
-   opentimer_id_t   id;
-   PORT_TIMER_WIDTH min_timeout;
-   bool             found;
-   
-   //step 1. reCount the ticks_remain after waking up from sleep
-   for(id=0; id<MAX_NUM_TIMERS; id++)
-   {
-     if (opentimers_vars.timersBuf[id].isrunning==TRUE) 
-     {
-       if(opentimers_vars.timersBuf[id].ticks_remaining > sleepTime)
-       {
-         opentimers_vars.timersBuf[id].ticks_remaining -= sleepTime;
-       }
-       else
-       {
-         if(opentimers_vars.timersBuf[id].wraps_remaining > 0)
-         {
-           opentimers_vars.timersBuf[id].wraps_remaining--;
-           opentimers_vars.timersBuf[id].ticks_remaining += (MAX_TICKS_IN_SINGLE_CLOCK - sleepTime);
-         }
-         else
-         {
-           opentimers_vars.timersBuf[id].hasExpired  = TRUE;
-         }
-       }
-     }
+/**
+\brief Remove a timer from the list of running timers.
+ */
+void opentimers_remove(opentimer_id_t id) {
+   opentimer_id_t prev;
+   opentimer_id_t next;
+
+   prev = opentimers_vars.timersBuf[id].prev;
+   next = opentimers_vars.timersBuf[id].next;
+
+   if (prev==TIMER_ID_NONE) {
+      opentimers_vars.head                   = next;
+   } else {
+      opentimers_vars.timersBuf[prev].next   = next;
+   }
+   if (next!=TIMER_ID_NONE) {
+      opentimers_vars.timersBuf[next].prev         = prev;
+      opentimers_vars.timersBuf[next].delta_ticks += opentimers_vars.timersBuf[id].delta_ticks;
    }
-   
-   // step 2. call callbacks of expired timers
-   for(id=0; id<MAX_NUM_TIMERS; id++) {
-      if (opentimers_vars.timersBuf[id].hasExpired==TRUE){
-
-         // call the callback
-         opentimers_vars.timersBuf[id].callback(id);
-         opentimers_vars.timersBuf[id].hasExpired     = FALSE;
-
-         // reload the timer, if applicable
-         if (opentimers_vars.timersBuf[id].type==TIMER_PERIODIC) {
-            opentimers_vars.timersBuf[id].wraps_remaining   = (opentimers_vars.timersBuf[id].period_ticks/MAX_TICKS_IN_SINGLE_CLOCK);//65535=maxValue of uint16_t
-            //if the number of ticks falls below a 16bit value, use it, otherwise set to max 16bit value
-            if(opentimers_vars.timersBuf[id].wraps_remaining==0)                                                
-               opentimers_vars.timersBuf[id].ticks_remaining   = opentimers_vars.timersBuf[id].period_ticks;
-            else
-               opentimers_vars.timersBuf[id].ticks_remaining = MAX_TICKS_IN_SINGLE_CLOCK;
 
-         } else {
-            opentimers_vars.timersBuf[id].isrunning   = FALSE;
-         }
+   opentimers_vars.timersBuf[id].prev        = TIMER_ID_NONE;
+   opentimers_vars.timersBuf[id].next        = TIMER_ID_NONE;
+}
+
+/**
+\brief Remove some elapsed ticks from the running timers.
+
+Timers which expire within these ticks are left at the head of the list with
+a delta_ticks of 0, and count how long ago their deadline passed in
+overdue_ticks, so their slack is not granted again from now.
+ */
+void opentimers_advance(uint32_t ticks) {
+   opentimer_id_t id;
+
+   id = opentimers_vars.head;
+   while (id!=TIMER_ID_NONE) {
+      if (opentimers_vars.timersBuf[id].delta_ticks>ticks) {
+         opentimers_vars.timersBuf[id].delta_ticks -= ticks;
+         break;
       }
+      ticks -= opentimers_vars.timersBuf[id].delta_ticks;
+      opentimers_vars.timersBuf[id].delta_ticks    = 0;
+      opentimers_vars.timersBuf[id].overdue_ticks += ticks;
+      id = opentimers_vars.timersBuf[id].next;
+   }
+}
+
+/**
+\brief Make the running timers relative to the current value of the counter.
+
+When called from within a callback, the timers stay relative to the compare
+event being handled, which opentimers_timer_callback() re-schedules from.
+ */
+void opentimers_rebase(void) {
+   PORT_TIMER_WIDTH now;
+   PORT_TIMER_WIDTH elapsed;
 
+   if (opentimers_vars.running==FALSE || opentimers_vars.inCallback==TRUE) {
+      return;
    }
-   
-   // step 3. find the minimum remaining timeout among running timers
-   found = FALSE;
-   for(id=0;id<MAX_NUM_TIMERS;id++) {
-      if (
-            opentimers_vars.timersBuf[id].isrunning==TRUE &&
-            (
-                  found==FALSE
-                  ||
-                  opentimers_vars.timersBuf[id].ticks_remaining < min_timeout
-            )
+
+   now     = bsp_timer_get_currentValue();
+   elapsed = (PORT_TIMER_WIDTH)(now-opentimers_vars.lastCompare);
+   opentimers_advance(elapsed);
+   opentimers_vars.lastCompare = now;
+
+   // the hardware timer still fires at the same time, relative to the new reference
+   if (elapsed<opentimers_vars.currentTimeout) {
+      opentimers_vars.currentTimeout -= elapsed;
+   } else {
+      opentimers_vars.currentTimeout  = 0;
+   }
+}
+
+/**
+\brief Fire all timers at the head of the list which have expired.
+
+Periodic timers are re-inserted before their callback is called, so the
+callback can stop them.
+ */
+void opentimers_expire(void) {
+   opentimer_id_t id;
+
+   opentimers_vars.inCallback = TRUE;
+
+   while (
+         opentimers_vars.head!=TIMER_ID_NONE &&
+         opentimers_vars.timersBuf[opentimers_vars.head].delta_ticks==0
       ) {
-         min_timeout    = opentimers_vars.timersBuf[id].ticks_remaining;
-         found          = TRUE;
+      id = opentimers_vars.head;
+      opentimers_remove(id);
+
+      // reload the timer, if applicable
+      if (opentimers_vars.timersBuf[id].type==TIMER_PERIODIC) {
+         if (opentimers_vars.timersBuf[id].period_ticks>0) {
+            opentimers_insert(id,opentimers_vars.timersBuf[id].period_ticks);
+         } else {
+            // never re-insert with 0 ticks, this would loop forever
+            opentimers_insert(id,1);
+         }
+      } else {
+         opentimers_vars.timersBuf[id].isrunning = FALSE;
       }
+
+      // call the callback
+      opentimers_vars.timersBuf[id].callback(id);
    }
 
-   // step 4. schedule next timeout
-   if (found==TRUE) {
-      // at least one timer pending
-      opentimers_vars.currentTimeout = min_timeout;
-      bsp_timer_scheduleIn(opentimers_vars.currentTimeout);
-   } else {
+   opentimers_vars.inCallback = FALSE;
+}
+
+/**
+\brief Schedule the hardware timer for the timer at the head of the list.
+
+\param rebase TRUE to schedule relative to the current value of the counter,
+   FALSE to schedule relative to the compare event which just happened.
+ */
+void opentimers_schedule(bool rebase) {
+   uint32_t ticks;
+
+   if (opentimers_vars.inCallback==TRUE) {
+      // opentimers_timer_callback() schedules once all callbacks are called
+      return;
+   }
+
+   if (opentimers_vars.head==TIMER_ID_NONE) {
       // no more timers pending
+      bsp_timer_cancel_schedule();
       opentimers_vars.running = FALSE;
+      return;
+   }
+
+   // wake up for the earliest deadline-plus-slack
+   ticks = opentimers_wakeupTicks();
+
+   // long timers are handled by waking up at the maximum timer value
+   if (ticks>MAX_TICKS_IN_SINGLE_CLOCK) {
+      ticks = MAX_TICKS_IN_SINGLE_CLOCK;
+   }
+   opentimers_vars.currentTimeout = (PORT_TIMER_WIDTH)ticks;
+
+   if (rebase==TRUE || opentimers_vars.running==FALSE) {
+      bsp_timer_reset();
+      opentimers_vars.lastCompare = bsp_timer_get_currentValue();
+   }
+   bsp_timer_scheduleIn(opentimers_vars.currentTimeout);
+   opentimers_vars.running = TRUE;
+}
+
+/**
+\brief Number of ticks after opentimers_vars.lastCompare the hardware timer
+   needs to fire at.
+
+\returns The earliest deadline-plus-slack among the running timers. The slack
+   of a timer whose deadline passed is what is left of it.
+ */
+uint32_t opentimers_wakeupTicks(void) {
+   opentimer_id_t id;
+   uint32_t       deadline;
+   uint32_t       wakeup;
+   uint32_t       slack;
+
+   deadline = 0;
+   wakeup   = 0xFFFFFFFF;
+   id       = opentimers_vars.head;
+   while (id!=TIMER_ID_NONE) {
+      deadline += opentimers_vars.timersBuf[id].delta_ticks;
+      if (deadline>=wakeup) {
+         // timers further down the list can not fire earlier
+         break;
+      }
+      slack = 0;
+      if (opentimers_vars.timersBuf[id].slack_ticks>opentimers_vars.timersBuf[id].overdue_ticks) {
+         slack = opentimers_vars.timersBuf[id].slack_ticks-opentimers_vars.timersBuf[id].overdue_ticks;
+      }
+      if (slack>=wakeup-deadline) {
+         // no earlier than the current wake-up time
+      } else {
+         wakeup = deadline+slack;
+      }
+      id = opentimers_vars.timersBuf[id].next;
    }
+
+   return wakeup;
+}
+
+/**
+\brief Function called when the hardware timer expires.
+
+Executed in interrupt mode.
+
+This function maps the expiration event to possibly multiple timers, calls the
+corresponding callback(s), and restarts the hardware timer with the next timer
+to expire.
+ */
+void opentimers_timer_callback() {
+
+   // the compare event which just happened is the new reference
+   opentimers_vars.lastCompare += opentimers_vars.currentTimeout;
+   opentimers_advance(opentimers_vars.currentTimeout);
+
+   // call callbacks of expired timers
+   opentimers_expire();
+
+   // schedule next timeout
+   opentimers_schedule(FALSE);
 }
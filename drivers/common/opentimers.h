@@ -19,12 +19,15 @@
 //=========================== define ==========================================
 
 /// Maximum number of timers that can run concurrently
-#define MAX_NUM_TIMERS            5
+#define MAX_NUM_TIMERS            20
 
 #define MAX_TICKS_IN_SINGLE_CLOCK ((PORT_TIMER_WIDTH)0xFFFFFFFF)
 
 #define TOO_MANY_TIMERS_ERROR     255
 
+/// Marks the end of the list of running timers
+#define TIMER_ID_NONE             255
+
 #define opentimer_id_t uint8_t
 
 typedef void (*opentimers_cbt)(opentimer_id_t id);
@@ -44,21 +47,25 @@ typedef enum {
 
 typedef struct {
    uint32_t             period_ticks;       // total number of clock ticks
-   PORT_TIMER_WIDTH     ticks_remaining;    // ticks remaining before elapses
-   uint16_t             wraps_remaining;    // the clock register is 16 bit, and can't count beyond 32k...
-                                            // so period_ticks = wraps_remaining*(32k or uint16_t)
+   uint32_t             delta_ticks;        // ticks between the expiry of the previous timer in the list and this one
+   uint32_t             slack_ticks;        // ticks the timer can fire late by, to share a wake-up with other events
+   uint32_t             overdue_ticks;      // ticks elapsed since the deadline, for a timer at delta_ticks 0 not fired yet
    timer_type_t         type;               // periodic or one-shot
    bool                 isrunning;          // is running?
    opentimers_cbt       callback;           // function to call when elapses
-   bool                 hasExpired;         // whether the callback has to be called
+   opentimer_id_t       prev;               // previous timer in the list of running timers
+   opentimer_id_t       next;               // next timer in the list of running timers
 } opentimers_t;
 
 //=========================== module variables ================================
 
 typedef struct {
    opentimers_t         timersBuf[MAX_NUM_TIMERS];
-   bool                 running;
+   opentimer_id_t       head;           // running timer which expires first
+   bool                 running;        // is the hardware timer scheduled?
+   bool                 inCallback;     // are we calling the callbacks of expired timers?
    PORT_TIMER_WIDTH     currentTimeout; // current timeout, in ticks
+   PORT_TIMER_WIDTH     lastCompare;    // value of the hardware counter currentTimeout is relative to
 } opentimers_vars_t;
 
 //=========================== prototypes ======================================
@@ -71,6 +78,8 @@ opentimer_id_t opentimers_start(uint32_t       duration,
 void           opentimers_setPeriod(opentimer_id_t id,time_type_t timetype, uint32_t       newPeriod);
 void           opentimers_stop(opentimer_id_t id);
 void           opentimers_restart(opentimer_id_t id);
+void           opentimers_setSlack(opentimer_id_t id, time_type_t timetype, uint32_t slack);
+void           opentimers_fireDueTimers(void);
 
 void           opentimers_sleepTimeCompesation(uint16_t sleepTime);
 
@@ -0,0 +1,265 @@
+/**
+\brief Definition of the "telemetry" driver.
+
+Most status elements openserial prints in a round-robin fashion do not change
+between two prints. This module keeps a copy of the last version of each
+element the PC got, and encodes the next version as the list of runs of bytes
+which changed:
+
+<pre>
+ +-----+------+-----+------+-----+-------+------+-----+-------+---
+ | row | kind | seq | skip | run | bytes | skip | run | bytes | ...
+ +-----+------+-----+------+-----+-------+------+-----+-------+---
+</pre>
+
+skip is the number of unchanged bytes since the end of the previous run, run
+the number of bytes which follow; both are varints. A keyframe carries the
+element in full instead. An element which did not change is not printed,
+except for the keyframe sent every TELEMETRY_KEYFRAME_PERIOD prints, which lets
+a PC attaching to a running mote catch up.
+*/
+
+#include "opendefs.h"
+#include "telemetry.h"
+
+//=========================== variables =======================================
+
+telemetry_vars_t telemetry_vars;
+
+//=========================== prototypes ======================================
+
+uint8_t telemetry_findSlot(uint8_t statusElement, uint8_t row, uint8_t length);
+uint8_t telemetry_encodeDelta(
+   uint8_t*         shadow,
+   uint8_t*         payload,
+   uint8_t          length,
+   uint8_t*         out
+);
+uint8_t telemetry_writeVarint(uint8_t* out, uint16_t value);
+
+//=========================== public ==========================================
+
+void telemetry_init() {
+   memset(&telemetry_vars,0,sizeof(telemetry_vars_t));
+}
+
+/**
+\brief Encode a status element against the last version the PC got.
+
+\param[in]  statusElement The status element, one of the STATUS_* values.
+\param[in]  payload       The element.
+\param[in]  length        Length of the element, in bytes.
+\param[out] body          Where to write the body of the telemetry frame, at
+   least TELEMETRY_MAX_BODY_LENGTH bytes.
+\param[out] bodyLength    Length of the body; 0 if nothing changed and no
+   keyframe is due, in which case no frame should be sent.
+
+\returns The slot tracking the element, to pass to telemetry_sent() once the
+   frame is in the serial output buffer; TELEMETRY_SLOT_NONE if the element
+   can not be tracked and should be printed as a plain status frame.
+*/
+uint8_t telemetry_encode(
+      uint8_t          statusElement,
+      uint8_t*         payload,
+      uint8_t          length,
+      uint8_t*         body,
+      uint8_t*         bodyLength
+   ) {
+   telemetry_slot_t* s;
+   uint8_t           slot;
+   uint8_t           row;
+   uint8_t           deltaLength;
+
+   *bodyLength = 0;
+
+   if (length==0 || length>TELEMETRY_MAX_LENGTH) {
+      return TELEMETRY_SLOT_NONE;
+   }
+
+   // table elements are printed one row at a time, their first byte is the row
+   switch (statusElement) {
+      case STATUS_SCHEDULE:
+      case STATUS_NEIGHBORS:
+         row = payload[0];
+         break;
+      default:
+         row = 0;
+         break;
+   }
+
+   slot = telemetry_findSlot(statusElement,row,length);
+   if (slot==TELEMETRY_SLOT_NONE) {
+      return TELEMETRY_SLOT_NONE;
+   }
+   s = &telemetry_vars.slots[slot];
+
+   body[0] = row;
+   body[2] = s->seq+1;
+
+   s->keyframe = (s->sinceKeyframe==0 || s->sinceKeyframe>=TELEMETRY_KEYFRAME_PERIOD);
+   s->sinceKeyframe++;
+   if (s->keyframe==FALSE) {
+      deltaLength = telemetry_encodeDelta(
+         &telemetry_vars.shadowPool[s->offset],
+         payload,
+         length,
+         &body[TELEMETRY_HEADER_LENGTH]
+      );
+      if (deltaLength==0) {
+         // nothing changed
+         return slot;
+      }
+      if (deltaLength<length) {
+         body[1]     = TELEMETRY_KIND_DELTA;
+         *bodyLength = TELEMETRY_HEADER_LENGTH+deltaLength;
+         return slot;
+      }
+      // the delta is no shorter than the element itself
+      s->keyframe = TRUE;
+   }
+
+   body[1]     = TELEMETRY_KIND_KEYFRAME;
+   memcpy(&body[TELEMETRY_HEADER_LENGTH],payload,length);
+   *bodyLength = TELEMETRY_HEADER_LENGTH+length;
+   return slot;
+}
+
+/**
+\brief Indicate the frame built by telemetry_encode() is in the output buffer.
+
+Only then is the copy of the element updated, so a frame dropped because the
+serial output buffer was full is encoded again against the right version.
+
+\param[in] slot    The slot returned by telemetry_encode().
+\param[in] payload The element passed to telemetry_encode().
+*/
+void telemetry_sent(uint8_t slot, uint8_t* payload) {
+   telemetry_slot_t* s;
+
+   s = &telemetry_vars.slots[slot];
+   memcpy(&telemetry_vars.shadowPool[s->offset],payload,s->length);
+   s->seq++;
+   if (s->keyframe==TRUE) {
+      s->sinceKeyframe = 1;
+   }
+}
+
+//=========================== private =========================================
+
+/**
+\brief Find the slot tracking an element, allocating one if needed.
+
+\returns The slot, or TELEMETRY_SLOT_NONE if there is no room left.
+*/
+uint8_t telemetry_findSlot(uint8_t statusElement, uint8_t row, uint8_t length) {
+   telemetry_slot_t* s;
+   uint8_t           i;
+
+   for (i=0;i<telemetry_vars.numSlots;i++) {
+      s = &telemetry_vars.slots[i];
+      if (s->statusElement==statusElement && s->row==row) {
+         if (s->length!=length) {
+            // elements have a fixed length, do not track this one
+            return TELEMETRY_SLOT_NONE;
+         }
+         return i;
+      }
+   }
+
+   if (
+         telemetry_vars.numSlots==TELEMETRY_NUM_SLOTS ||
+         telemetry_vars.poolFill+length>TELEMETRY_POOL_SIZE
+      ) {
+      return TELEMETRY_SLOT_NONE;
+   }
+
+   s                 = &telemetry_vars.slots[telemetry_vars.numSlots];
+   s->statusElement  = statusElement;
+   s->row            = row;
+   s->length         = length;
+   s->seq            = 0;
+   s->sinceKeyframe  = 0;
+   s->offset         = telemetry_vars.poolFill;
+   telemetry_vars.poolFill += length;
+
+   return telemetry_vars.numSlots++;
+}
+
+/**
+\brief Write the runs of bytes of payload which differ from shadow.
+
+\returns The number of bytes written, 0 if nothing changed. Writing stops once
+   the delta reaches the length of the element, out must hold length+2 bytes.
+*/
+uint8_t telemetry_encodeDelta(
+      uint8_t*         shadow,
+      uint8_t*         payload,
+      uint8_t          length,
+      uint8_t*         out
+   ) {
+   uint8_t i;
+   uint8_t start;
+   uint8_t end;
+   uint8_t numEqual;
+   uint8_t last;
+   uint8_t outLength;
+
+   outLength = 0;
+   last      = 0;
+   i         = 0;
+   while (i<length && outLength<length) {
+      if (payload[i]==shadow[i]) {
+         i++;
+         continue;
+      }
+
+      // a run starts here, it ends before TELEMETRY_MAX_GAP+1 unchanged bytes
+      start    = i;
+      end      = i+1;
+      numEqual = 0;
+      for (i=start+1;i<length;i++) {
+         if (payload[i]==shadow[i]) {
+            numEqual++;
+            if (numEqual>TELEMETRY_MAX_GAP) {
+               break;
+            }
+         } else {
+            numEqual = 0;
+            end      = i+1;
+         }
+      }
+
+      outLength += telemetry_writeVarint(&out[outLength],start-last);
+      outLength += telemetry_writeVarint(&out[outLength],end-start);
+      if (outLength+(end-start)>length) {
+         // no shorter than a keyframe
+         return length;
+      }
+      memcpy(&out[outLength],&payload[start],end-start);
+      outLength += end-start;
+
+      last = end;
+      i    = end;
+   }
+
+   return outLength;
+}
+
+/**
+\brief Write value as a varint: 7 bits per byte, least significant first, the
+   top bit set on all bytes but the last.
+
+\returns The number of bytes written.
+*/
+port_INLINE uint8_t telemetry_writeVarint(uint8_t* out, uint16_t value) {
+   uint8_t numBytes;
+
+   numBytes = 0;
+   while (value>=0x80) {
+      out[numBytes++] = (value & 0x7f) | 0x80;
+      value         >>= 7;
+   }
+   out[numBytes++] = (uint8_t)value;
+
+   return numBytes;
+}
@@ -0,0 +1,87 @@
+/**
+\brief Declaration of the "telemetry" driver.
+*/
+
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include "opendefs.h"
+
+/**
+\addtogroup drivers
+\{
+\addtogroup Telemetry
+\{
+*/
+
+//=========================== define ==========================================
+
+/// Number of status elements (or rows of a status table) which can be tracked.
+#define TELEMETRY_NUM_SLOTS           32
+
+/// Number of bytes of the pool holding the last-sent copy of each element.
+#define TELEMETRY_POOL_SIZE           640
+
+/// Status elements longer than this are always printed in full.
+#define TELEMETRY_MAX_LENGTH          64
+
+/// Every element is sent in full at least once every that many prints.
+#define TELEMETRY_KEYFRAME_PERIOD     16
+
+/// Runs of changed bytes separated by at most this many unchanged bytes are merged.
+#define TELEMETRY_MAX_GAP             2
+
+/// Bytes preceding the payload of a telemetry frame: row, kind, sequence number.
+#define TELEMETRY_HEADER_LENGTH       3
+
+/// Maximum length of the body of a telemetry frame, a delta may overshoot by the varints of its last run.
+#define TELEMETRY_MAX_BODY_LENGTH     (TELEMETRY_HEADER_LENGTH+TELEMETRY_MAX_LENGTH+2)
+
+/// Returned by telemetry_encode() when the element can not be tracked.
+#define TELEMETRY_SLOT_NONE           0xff
+
+/// Kind of a telemetry frame.
+enum {
+   TELEMETRY_KIND_KEYFRAME = 0, ///< The payload is the element, in full.
+   TELEMETRY_KIND_DELTA    = 1, ///< The payload lists the bytes which changed.
+};
+
+//=========================== typedef =========================================
+
+typedef struct {
+   uint8_t    statusElement;
+   uint8_t    row;              // first byte of table elements, 0 otherwise
+   uint8_t    length;           // length of the element, in bytes
+   uint8_t    seq;              // sequence number of the last frame the PC got
+   uint8_t    sinceKeyframe;    // prints since the last keyframe
+   bool       keyframe;         // is the frame being sent a keyframe?
+   uint16_t   offset;           // offset of the last-sent copy in shadowPool
+} telemetry_slot_t;
+
+//=========================== module variables ================================
+
+typedef struct {
+   telemetry_slot_t slots[TELEMETRY_NUM_SLOTS];
+   uint8_t          numSlots;
+   uint16_t         poolFill;
+   uint8_t          shadowPool[TELEMETRY_POOL_SIZE];
+} telemetry_vars_t;
+
+//=========================== prototypes ======================================
+
+void    telemetry_init(void);
+uint8_t telemetry_encode(
+   uint8_t          statusElement,
+   uint8_t*         payload,
+   uint8_t          length,
+   uint8_t*         body,
+   uint8_t*         bodyLength
+);
+void    telemetry_sent(uint8_t slot, uint8_t* payload);
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -110,7 +110,9 @@ enum {
    STATUS_SCHEDULE                     =  6,
    STATUS_QUEUE                        =  7,
    STATUS_NEIGHBORS                    =  8,
-   STATUS_MAX                          =  9,
+   STATUS_SERIAL                       =  9,
+   STATUS_ENERGY                       = 10,
+   STATUS_MAX                          = 11,
 };
 
 //component identifiers
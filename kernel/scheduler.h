@@ -24,11 +24,13 @@ typedef enum {
    TASKPRIO_COAP                  = 0x06,
    TASKPRIO_ADAPTIVE_SYNC         = 0x07, 
    TASKPRIO_OTF                   = 0x08,
+   TASKPRIO_LIGHT_SAMPLE          = 0x09,
    // tasks trigger by other interrupts
-   TASKPRIO_BUTTON                = 0x09,
-   TASKPRIO_SIXTOP_TIMEOUT        = 0x0a,
-   TASKPRIO_SNIFFER               = 0x0b,
-   TASKPRIO_MAX                   = 0x0c,
+   TASKPRIO_BUTTON                = 0x0a,
+   TASKPRIO_SIXTOP_TIMEOUT        = 0x0b,
+   TASKPRIO_SNIFFER               = 0x0c,
+   TASKPRIO_OPENSERIAL            = 0x0d,
+   TASKPRIO_MAX                   = 0x0e,
 } task_prio_t;
 
 #define TASK_LIST_DEPTH           10
@@ -0,0 +1,611 @@
+#!/usr/bin/python
+'''
+Fast parser for the serial logs captured from the motes.
+
+A log file is memory-mapped and cut into HDLC frames with a regular
+expression, so the scanning happens in C rather than one byte at a time. The
+escaping is undone with two string replacements, and the CRC is checked with
+binascii.crc_hqx on the bit-reversed frame. Frames are decoded with
+precompiled struct.Struct objects and streamed, one CSV file per kind of
+record, so the memory used does not grow with the size of the log.
+
+Next to each log, a <log>.idx file records how far the log was parsed, the
+decoder state at that point, and the byte ranges of chunks of frames with the
+ASN range and kinds of records they hold. A later run only parses what was
+appended to the log, and records of an ASN range can be read without parsing
+the whole log. Logs are parsed in parallel, one per worker process.
+
+Works with Python 2.7 and Python 3.
+'''
+
+import argparse
+import binascii
+import csv
+import hashlib
+import json
+import mmap
+import multiprocessing
+import os
+import re
+import struct
+import sys
+
+import StackDefines
+
+#============================ defines =========================================
+
+HDLC_FLAG              = b'\x7e'
+HDLC_ESCAPE            = b'\x7d'
+HDLC_CRCINIT           = 0xffff
+HDLC_CRCGOOD           = 0xf0b8
+
+# runs of bytes between two flags
+FRAME_RE               = re.compile(b'[^\x7e]+')
+
+# bit-reversal of a byte, to compute the (LSB-first) HDLC CRC with the
+# (MSB-first) binascii.crc_hqx
+REV8                   = [int('{0:08b}'.format(i)[::-1],2) for i in range(256)]
+REV8_TABLE             = bytes(bytearray(REV8))
+
+# longest run of bytes without a flag kept while waiting for the end of a frame
+MAX_PENDING_LENGTH     = 1024
+
+INDEX_VERSION          = 1
+INDEX_CHUNK_RECORDS    = 4096     # records per chunk of the index
+INDEX_FINGERPRINT_SIZE = 4096     # bytes at the start of a log identifying it
+
+TELEMETRY_KIND_KEYFRAME = 0
+TELEMETRY_KIND_DELTA    = 1
+
+# energy_budget_t and energy_load_t in openstack/cross-layers/energy.h
+ENERGY_BUDGETS = ('eb','flood','sync','serial','idle')
+ENERGY_LOADS   = ('cpu','sleep','rx','tx')
+
+# status elements, see STATUS_* in inc/opendefs.h
+# type: (name, struct, fields)
+STATUS_DECODERS = {
+    0: ('isSync',           struct.Struct('<B'),              ('isSync',)),
+    1: ('idManager',        struct.Struct('<BHH'),            ('isDAGroot','myPANID','my16bID')),
+    2: ('myDagRank',        struct.Struct('<H'),              ('myDAGrank',)),
+    3: ('outBufferIndexes', struct.Struct('<HHHHHHHHH'),      (
+        'errorIdxW','errorIdxR','errorNumDropped',
+        'dataIdxW','dataIdxR','dataNumDropped',
+        'statusIdxW','statusIdxR','statusNumDropped',
+    )),
+    4: ('asn',              struct.Struct('<BHH'),            ('asn_4','asn_2_3','asn_0_1')),
+    5: ('macStats',         struct.Struct('<BBhhBII'),        (
+        'numSyncPkt','numSyncAck','minCorrection','maxCorrection','numDeSync','numTicsOn','numTicsTotal',
+    )),
+    6: ('scheduleRow',      struct.Struct('<BHBBBB'),         (
+        'row','slotOffset','channelOffset','type','numRx','numTx',
+    )),
+    7: ('queue',            struct.Struct('<'+'BB'*20),       sum([('creator{0}'.format(i),'owner{0}'.format(i)) for i in range(20)],())),
+    8: ('neighborsRow',     struct.Struct('<BBBBBHHbBBBBHH'), (
+        'row','used','parentPreference','stableNeighbor','switchStabilityCounter',
+        'shortID','DAGrank','rssi','numRx','numTx','numWraps','asn_4','asn_2_3','asn_0_1',
+    )),
+    9: ('serial',           struct.Struct('<HHHBB'),          (
+        'budget','numBytesOut','numBytesIn','numWindows','numBudgetExhausted',
+    )),
+    10: ('energy',          struct.Struct('<'+'I'*20+'HBII'), tuple(
+        '{0}_{1}_uC'.format(b,l) for b in ENERGY_BUDGETS for l in ENERGY_LOADS
+    )+(
+        'burstOrigin','burstId','burstFlood_uC','burstTotal_uC',
+    )),
+}
+
+SEVERITIES = {
+    b'I': 'info',
+    b'E': 'error',
+    b'C': 'critical',
+}
+
+ERROR_STRUCT = struct.Struct('>HBBHH')
+DATA_STRUCT  = struct.Struct('<HHHB')
+
+# light_trace_t in openapps/light/light.h, printed as a DATA frame
+LIGHT_TRACE_MARKER = 0x4c
+LIGHT_TRACE_STRUCT = struct.Struct('<BHBBBII')
+
+# record of the flash log, see drivers/common/flashlog.c: ASN, then the frame
+FLASHLOG_STRUCT     = struct.Struct('<HHHB')
+FLASHLOG_END_STRUCT = struct.Struct('>HH')
+
+#============================ helpers =========================================
+
+def crc16(frame):
+    '''
+    HDLC CRC of a frame, computed over its bit-reversed bytes by the C
+    implementation of CRC-CCITT.
+    '''
+    crc = binascii.crc_hqx(frame.translate(REV8_TABLE),HDLC_CRCINIT)
+    return (REV8[crc&0xff]<<8) | REV8[crc>>8]
+
+def dehdlc(raw):
+    '''
+    Undo the escaping of an HDLC frame and check its CRC.
+
+    \returns the frame without its CRC, None if the CRC is wrong.
+    '''
+    if HDLC_ESCAPE in raw:
+        # the order matters: 7d5d5e is an escaped 7d followed by 5e
+        raw = raw.replace(b'\x7d\x5e',b'\x7e').replace(b'\x7d\x5d',b'\x7d')
+    if len(raw)<3 or crc16(raw)!=HDLC_CRCGOOD:
+        return None
+    return raw[:-2]
+
+def parseVarint(buf,idx):
+    value = 0
+    shift = 0
+    while True:
+        b      = buf[idx]
+        idx   += 1
+        value |= (b&0x7f)<<shift
+        shift += 7
+        if not b&0x80:
+            return (value,idx)
+
+#============================ classes =========================================
+
+class FrameParser(object):
+    '''
+    Decode the frames of one log, one record at a time.
+
+    A record is a (kind,columns,values) tuple, kind being 'error', 'data' or
+    'status_<name>'. Records are tagged with the last ASN the mote reported,
+    through a data frame or its ASN status element.
+    '''
+
+    def __init__(self):
+        # last version of each status element, per (mote,statusElement,row)
+        self.telemetryShadows = {}
+        self.lastAsn          = None
+        self.end              = 0      # offset after the last complete frame
+        self.pending          = b''    # bytes fed but not yet parsed
+        self.pendingOffset    = 0      # offset of pending in the stream
+        self.numFrames        = 0
+        self.numBadCrc        = 0
+        self.numUnknown       = 0
+
+    def frames(self,buf,offset=0,end=None):
+        '''
+        Iterate over the valid frames of buf, as (offset,frame) tuples.
+
+        A frame still being written at the end of the log, i.e. not followed
+        by a flag, is left for the next run.
+        '''
+        if end is None:
+            end = len(buf)
+        self.end = offset
+        for m in FRAME_RE.finditer(buf,offset,end):
+            if m.end()>=len(buf):
+                break
+            self.end = m.end()+1
+            frame = dehdlc(m.group())
+            if frame is None:
+                self.numBadCrc += 1
+                continue
+            self.numFrames += 1
+            yield (m.start(),frame)
+
+    def records(self,buf,offset=0,end=None):
+        '''
+        Iterate over the records of buf, as (offset,asn,kind,columns,values)
+        tuples.
+        '''
+        for (pos,frame) in self.frames(buf,offset,end):
+            record = self.parseFrame(frame)
+            if record is None:
+                continue
+            yield (pos,self.lastAsn)+record
+
+    def feed(self,data):
+        '''
+        Iterate over the records completed by data, the next bytes of a
+        stream, e.g. read from a growing log or a serial port.
+
+        Offsets are counted from the first byte fed.
+        '''
+        buf = self.pending+data
+        for (pos,asn,kind,columns,values) in self.records(buf):
+            yield (self.pendingOffset+pos,asn,kind,columns,values)
+        self.pendingOffset += self.end
+        buf                 = buf[self.end:]
+        if len(buf)>MAX_PENDING_LENGTH:
+            # not a frame, a flag was lost
+            self.numBadCrc     += 1
+            self.pendingOffset += len(buf)
+            buf                 = b''
+        self.pending        = buf
+
+    def getState(self):
+        '''
+        Decoder state, as stored in the index.
+        '''
+        return {
+            'lastAsn':   self.lastAsn,
+            'telemetry': [
+                [binascii.hexlify(k[0]).decode('ascii'),k[1],seq,binascii.hexlify(bytes(element)).decode('ascii')]
+                for (k,(seq,element)) in self.telemetryShadows.items()
+            ],
+        }
+
+    def setState(self,state):
+        self.lastAsn          = state['lastAsn']
+        self.telemetryShadows = {}
+        for (key,row,seq,element) in state['telemetry']:
+            self.telemetryShadows[(binascii.unhexlify(key),row)] = (seq,bytearray(binascii.unhexlify(element)))
+
+    def parseFrame(self,frame):
+        t = frame[:1]
+        if   t==b'S':
+            return self.parseStatus(frame,bytearray(frame[4:]))
+        elif t==b'T':
+            return self.parseTelemetry(frame)
+        elif t in SEVERITIES:
+            return self.parseError(frame)
+        elif t==b'D':
+            return self.parseData(frame)
+        elif t==b'L':
+            return self.parseFlashlog(frame)
+        self.numUnknown += 1
+        return None
+
+    #======================== frame parsers ===================================
+
+    def parseStatus(self,frame,element):
+        statusType = bytearray(frame[3:4])[0]
+        if statusType not in STATUS_DECODERS:
+            self.numUnknown += 1
+            return None
+        (name,st,fields) = STATUS_DECODERS[statusType]
+        if len(element)<st.size:
+            self.numUnknown += 1
+            return None
+        (src,)  = struct.unpack_from('>H',frame,1)
+        values  = st.unpack_from(bytes(element))
+        if statusType==4:
+            self.lastAsn = (values[0]<<32) | (values[1]<<16) | values[2]
+        return ('status_'+name,('src',)+fields,(src,)+values)
+
+    def parseTelemetry(self,frame):
+        '''
+        A telemetry frame carries a status element, either in full (keyframe)
+        or as the runs of bytes which changed since the previous frame.
+        '''
+        head           = bytearray(frame[1:7])
+        if len(head)<6:
+            return None
+        (row,kind,seq) = head[3:6]
+        body           = bytearray(frame[7:])
+        key            = (bytes(frame[1:4]),row)
+
+        if   kind==TELEMETRY_KIND_KEYFRAME:
+            element    = body
+        elif kind==TELEMETRY_KIND_DELTA:
+            if key not in self.telemetryShadows:
+                # wait for a keyframe
+                return None
+            (lastSeq,element) = self.telemetryShadows[key]
+            if seq!=(lastSeq+1)&0xff:
+                # missed a frame, wait for a keyframe
+                del self.telemetryShadows[key]
+                return None
+            element    = bytearray(element)
+            idx        = 0
+            pos        = 0
+            while idx<len(body):
+                (skip,idx) = parseVarint(body,idx)
+                (run,idx)  = parseVarint(body,idx)
+                pos       += skip
+                element[pos:pos+run] = body[idx:idx+run]
+                pos       += run
+                idx       += run
+        else:
+            return None
+
+        self.telemetryShadows[key] = (seq,element)
+        return self.parseStatus(frame,element)
+
+    def parseError(self,frame):
+        if len(frame)<1+ERROR_STRUCT.size:
+            return None
+        (src,component,errcode,arg1,arg2) = ERROR_STRUCT.unpack_from(frame,1)
+        try:
+            description = StackDefines.errorDescriptions[errcode].format(arg1,arg2)
+        except (KeyError,IndexError):
+            description = ''
+        return (
+            'error',
+            ('src','severity','component','errcode','arg1','arg2','description'),
+            (src,SEVERITIES[frame[:1]],StackDefines.components.get(component,component),errcode,arg1,arg2,description),
+        )
+
+    def parseData(self,frame):
+        if len(frame)<1+DATA_STRUCT.size:
+            return None
+        (src,asn_0_1,asn_2_3,asn_4) = DATA_STRUCT.unpack_from(frame,1)
+        # the short address is written least significant byte first
+        src = ((src&0xff)<<8) | (src>>8)
+        self.lastAsn = (asn_4<<32) | (asn_2_3<<16) | asn_0_1
+        payload      = frame[1+DATA_STRUCT.size:]
+        if len(payload)==LIGHT_TRACE_STRUCT.size and bytearray(payload[:1])[0]==LIGHT_TRACE_MARKER:
+            (_,origin,burstId,pktId,hops,originAsn,rxAsn) = LIGHT_TRACE_STRUCT.unpack(payload)
+            return (
+                'lightTrace',
+                ('src','origin','burstId','pktId','hops','originAsn','rxAsn','latency'),
+                (src,origin,burstId,pktId,hops,originAsn,rxAsn,(rxAsn-originAsn)&0xffffffff),
+            )
+        return (
+            'data',
+            ('src','payload'),
+            (src,binascii.hexlify(payload).decode('ascii')),
+        )
+
+    def parseFlashlog(self,frame):
+        '''
+        A flashlog frame carries a record dumped from the flash of the mote,
+        i.e. a frame printed by an earlier run, with the ASN it was printed
+        at. The last frame of a dump only holds the number of records the
+        mote dropped.
+
+        These ASNs are from the past, they do not change lastAsn.
+        '''
+        if len(frame)==FLASHLOG_END_STRUCT.size+1:
+            # big endian, so the short address comes out as in parseData()
+            (src,numDropped) = FLASHLOG_END_STRUCT.unpack_from(frame,1)
+            return ('flashlogEnd',('src','numDropped'),(src,numDropped))
+        if len(frame)<1+FLASHLOG_STRUCT.size+1:
+            return None
+        (src,asn_0_1,asn_2_3,asn_4) = FLASHLOG_STRUCT.unpack_from(frame,1)
+        src     = ((src&0xff)<<8) | (src>>8)
+        asn     = (asn_4<<32) | (asn_2_3<<16) | asn_0_1
+        logged  = frame[1+FLASHLOG_STRUCT.size:]
+        return (
+            'flashlog',
+            ('src','asn','type','frame'),
+            (src,asn,logged[:1].decode('ascii','replace'),binascii.hexlify(logged[1:]).decode('ascii')),
+        )
+
+class ColumnarWriter(object):
+    '''
+    Write records to one CSV file per kind, <prefix>.<kind>.csv.
+
+    In append mode, records are added to the existing files.
+    '''
+
+    def __init__(self,prefix,append=False):
+        self.prefix  = prefix
+        self.append  = append
+        self.files   = {}
+        self.writers = {}
+
+    def write(self,offset,asn,kind,columns,values):
+        if kind not in self.writers:
+            filename = '{0}.{1}.csv'.format(self.prefix,kind)
+            exists   = self.append and os.path.exists(filename)
+            mode     = 'a' if self.append else 'w'
+            if sys.version_info[0]<3:
+                f = open(filename,mode+'b')
+            else:
+                f = open(filename,mode,newline='')
+            self.files[kind]   = f
+            self.writers[kind] = csv.writer(f)
+            if not exists:
+                self.writers[kind].writerow(('offset','asn')+tuple(columns))
+        self.writers[kind].writerow((offset,asn)+tuple(values))
+
+    def close(self):
+        for f in self.files.values():
+            f.close()
+
+class Index(object):
+    '''
+    The <log>.idx file of a log.
+    '''
+
+    def __init__(self,filename):
+        self.filename = filename+'.idx'
+        self.data     = None
+        if os.path.exists(self.filename):
+            try:
+                with open(self.filename,'r') as f:
+                    self.data = json.load(f)
+            except ValueError:
+                self.data = None
+        if self.data is not None and self.data.get('version')!=INDEX_VERSION:
+            self.data = None
+
+    def matches(self,buf,prefix):
+        '''
+        Whether the index describes the beginning of this log, parsed to CSV
+        files with this prefix.
+        '''
+        return (
+            self.data is not None                               and
+            self.data['prefix']==prefix                         and
+            self.data['end']<=len(buf)                          and
+            self.data['fingerprint']==fingerprint(buf,self.data['end'])
+        )
+
+    def reset(self,prefix):
+        self.data = {
+            'version':     INDEX_VERSION,
+            'prefix':      prefix,
+            'fingerprint': None,
+            'end':         0,
+            'state':       None,
+            'counters':    {'numFrames':0,'numBadCrc':0,'numUnknown':0},
+            'chunks':      [],
+        }
+
+    def save(self):
+        tmp = self.filename+'.tmp'
+        with open(tmp,'w') as f:
+            json.dump(self.data,f)
+        if os.path.exists(self.filename):
+            os.remove(self.filename)
+        os.rename(tmp,self.filename)
+
+    def chunksForAsn(self,asnMin,asnMax):
+        '''
+        Chunks which may hold records in the [asnMin,asnMax] ASN range.
+        '''
+        for chunk in self.data['chunks']:
+            if chunk['asnMin'] is None:
+                # no ASN known yet, can not tell
+                yield chunk
+            elif chunk['asnMax']>=asnMin and chunk['asnMin']<=asnMax:
+                yield chunk
+
+#============================ public ==========================================
+
+def mapFile(filename):
+    '''
+    Memory-map a log file.
+
+    \returns the map, or an empty string if the file is empty.
+    '''
+    with open(filename,'rb') as f:
+        if os.fstat(f.fileno()).st_size==0:
+            return b''
+        return mmap.mmap(f.fileno(),0,access=mmap.ACCESS_READ)
+
+def fingerprint(buf,end):
+    '''
+    Hash of the start of a log, to detect a log which was replaced.
+    '''
+    return hashlib.md5(buf[:min(end,INDEX_FINGERPRINT_SIZE)]).hexdigest()
+
+def parseFile(filename,outPrefix):
+    '''
+    Parse one log file into CSV files, starting where the previous run
+    stopped if the log only grew since.
+
+    \returns a (filename,counters,resumedFrom) tuple.
+    '''
+    buf    = mapFile(filename)
+    index  = Index(filename)
+    parser = FrameParser()
+    try:
+        if index.matches(buf,outPrefix):
+            parser.setState(index.data['state'])
+            append = True
+        else:
+            index.reset(outPrefix)
+            append = False
+        start  = index.data['end']
+        writer = ColumnarWriter(outPrefix,append)
+        chunk  = None
+        asn    = parser.lastAsn
+        try:
+            for record in parser.records(buf,start):
+                if chunk is None:
+                    # the ASN before the chunk tags its first records
+                    chunk = {'start':record[0],'end':None,'lastAsn':asn,'asnMin':asn,'asnMax':asn,'kinds':{}}
+                asn = record[1]
+                if asn is not None:
+                    if chunk['asnMin'] is None or asn<chunk['asnMin']:
+                        chunk['asnMin'] = asn
+                    if chunk['asnMax'] is None or asn>chunk['asnMax']:
+                        chunk['asnMax'] = asn
+                chunk['kinds'][record[2]] = chunk['kinds'].get(record[2],0)+1
+                writer.write(*record)
+                if sum(chunk['kinds'].values())>=INDEX_CHUNK_RECORDS:
+                    chunk['end'] = parser.end
+                    index.data['chunks'].append(chunk)
+                    chunk = None
+            if chunk is not None:
+                chunk['end'] = parser.end
+                index.data['chunks'].append(chunk)
+        finally:
+            writer.close()
+        counters = index.data['counters']
+        counters['numFrames']      += parser.numFrames
+        counters['numBadCrc']      += parser.numBadCrc
+        counters['numUnknown']     += parser.numUnknown
+        index.data['end']           = max(parser.end,start)
+        index.data['fingerprint']   = fingerprint(buf,index.data['end'])
+        index.data['state']         = parser.getState()
+        index.save()
+    finally:
+        if isinstance(buf,mmap.mmap):
+            buf.close()
+    return (filename,counters,start)
+
+def parseFiles(filenames,outPrefixes,jobs=None):
+    '''
+    Parse log files in parallel, one per worker process.
+
+    \returns the list of the parseFile() results.
+    '''
+    if jobs==1 or len(filenames)<2:
+        return [parseFile(f,p) for (f,p) in zip(filenames,outPrefixes)]
+    pool = multiprocessing.Pool(processes=jobs)
+    try:
+        return pool.map(parseFileStar,zip(filenames,outPrefixes))
+    finally:
+        pool.close()
+        pool.join()
+
+def parseFileStar(args):
+    return parseFile(*args)
+
+def recordsInAsnRange(filename,asnMin,asnMax):
+    '''
+    Iterate over the records of a log tagged with an ASN in [asnMin,asnMax],
+    parsing only the chunks of the index which may hold some.
+
+    \note Telemetry deltas are decoded only after the next keyframe of their
+           status element in each chunk.
+    '''
+    index = Index(filename)
+    if index.data is None:
+        raise ValueError('{0} has no index, parse it first'.format(filename))
+    buf   = mapFile(filename)
+    try:
+        for chunk in index.chunksForAsn(asnMin,asnMax):
+            parser = FrameParser()
+            parser.lastAsn = chunk['lastAsn']
+            for record in parser.records(buf,chunk['start'],chunk['end']):
+                if record[1] is not None and asnMin<=record[1]<=asnMax:
+                    yield record
+    finally:
+        if isinstance(buf,mmap.mmap):
+            buf.close()
+
+#============================ main ============================================
+
+def main():
+    argparser = argparse.ArgumentParser(description='Parse the serial logs of the motes into CSV files.')
+    argparser.add_argument('files',nargs='+',help='log files')
+    argparser.add_argument('-o','--outdir',default=None,help='directory for the CSV files (default: next to each log)')
+    argparser.add_argument('-j','--jobs',type=int,default=None,help='number of worker processes (default: one per core)')
+    argparser.add_argument('--asn',default=None,metavar='MIN:MAX',help='only write the records of this ASN range, using the index')
+    args = argparser.parse_args()
+
+    outPrefixes = []
+    for filename in args.files:
+        if args.outdir:
+            outPrefixes += [os.path.join(args.outdir,os.path.basename(filename))]
+        else:
+            outPrefixes += [filename]
+
+    if args.asn:
+        (asnMin,asnMax) = [int(v,0) for v in args.asn.split(':')]
+        for (filename,outPrefix) in zip(args.files,outPrefixes):
+            writer = ColumnarWriter('{0}.asn{1}-{2}'.format(outPrefix,asnMin,asnMax))
+            try:
+                for record in recordsInAsnRange(filename,asnMin,asnMax):
+                    writer.write(*record)
+            finally:
+                writer.close()
+        return
+
+    for (filename,counters,resumedFrom) in parseFiles(args.files,outPrefixes,args.jobs):
+        sys.stdout.write('{0}: {1} frames, {2} bad CRC, {3} unknown (parsed from byte {4})\n'.format(
+            filename,counters['numFrames'],counters['numBadCrc'],counters['numUnknown'],resumedFrom,
+        ))
+
+if __name__ == "__main__":
+    main()
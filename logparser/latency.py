@@ -0,0 +1,98 @@
+#!/usr/bin/python
+'''
+Latency of the light floods, from the event at the sensor to every mote.
+
+Each mote prints a light_trace_t DATA frame the first time it receives a
+packet of a burst, carrying the ASN of the light event at the sensor, the ASN
+it received the packet at and its distance to the sensor in hops. This script
+parses the logs with fastparser, groups the traces by event (the sensor and the
+ASN of the event identify it, the burstId wraps every 16 events) and prints,
+for each sensor and each mote, the distribution of the latencies and the number
+of events missed.
+
+Works with Python 2.7 and Python 3.
+'''
+
+import argparse
+import collections
+import csv
+import os
+import sys
+
+import fastparser
+
+#============================ defines =========================================
+
+# PORT_TsSlotDuration of the OpenMote-CC2538, in 32768 Hz ticks
+DEFAULT_SLOT_TICKS = 197
+
+#============================ helpers =========================================
+
+def percentile(values,p):
+    '''
+    Nearest-rank percentile of sorted values.
+    '''
+    idx = int(round(p/100.0*(len(values)-1)))
+    return values[idx]
+
+def readTraces(prefixes):
+    '''
+    \returns a {origin: {originAsn: {src: (latency,hops)}}} dictionary.
+    '''
+    events = collections.defaultdict(lambda: collections.defaultdict(dict))
+    for prefix in prefixes:
+        filename = '{0}.lightTrace.csv'.format(prefix)
+        if not os.path.exists(filename):
+            continue
+        with open(filename,'r') as f:
+            for row in csv.DictReader(f):
+                origin    = int(row['origin'])
+                originAsn = int(row['originAsn'])
+                src       = int(row['src'])
+                if src in events[origin][originAsn]:
+                    # the mote rebooted or the log was parsed twice, keep the first
+                    continue
+                events[origin][originAsn][src] = (int(row['latency']),int(row['hops']))
+    return events
+
+def report(origins,slotMs,out=sys.stdout):
+    for origin in sorted(origins):
+        reportOrigin(origin,origins[origin],slotMs,out)
+
+def reportOrigin(origin,events,slotMs,out):
+    motes = sorted(set(src for receptions in events.values() for src in receptions))
+
+    out.write('sensor {0:04x}: {1} events\n\n'.format(origin,len(events)))
+    out.write('{0:>6} {1:>6} {2:>7} {3:>9} {4:>9} {5:>9} {6:>9} {7:>9}  {8}\n'.format(
+        'mote','events','missed','min','median','p90','p99','max','hops',
+    ))
+    for src in motes:
+        latencies = sorted(r[src][0] for r in events.values() if src in r)
+        hops      = collections.Counter(r[src][1] for r in events.values() if src in r)
+        out.write('{0:>6} {1:>6} {2:>7} {3:>9} {4:>9} {5:>9} {6:>9} {7:>9}  {8}\n'.format(
+            '{0:04x}'.format(src),
+            len(latencies),
+            len(events)-len(latencies),
+            '{0:.1f}ms'.format(latencies[0]*slotMs),
+            '{0:.1f}ms'.format(percentile(latencies,50)*slotMs),
+            '{0:.1f}ms'.format(percentile(latencies,90)*slotMs),
+            '{0:.1f}ms'.format(percentile(latencies,99)*slotMs),
+            '{0:.1f}ms'.format(latencies[-1]*slotMs),
+            ' '.join('{0}:{1}'.format(k,hops[k]) for k in sorted(hops)),
+        ))
+    out.write('\n')
+
+#============================ main ============================================
+
+def main():
+    argparser = argparse.ArgumentParser(description='Print the latency of the light floods to every mote.')
+    argparser.add_argument('files',nargs='+',help='log files, one per mote')
+    argparser.add_argument('-j','--jobs',type=int,default=None,help='number of worker processes (default: one per core)')
+    argparser.add_argument('--slot-ticks',type=int,default=DEFAULT_SLOT_TICKS,help='slot duration, in 32768 Hz ticks')
+    args = argparser.parse_args()
+
+    fastparser.parseFiles(args.files,args.files,args.jobs)
+    report(readTraces(args.files),args.slot_ticks*1000.0/32768)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,223 @@
+#!/usr/bin/python
+'''
+Follow the serial output of motes while an experiment runs.
+
+Each source is a growing capture file, or a serial port (anything under /dev/
+or named COM<n>, read with pyserial). Bytes are decoded as they arrive by a
+fastparser.FrameParser per source, and a table of rolling metrics per mote is
+printed every --period seconds:
+
+- sync state and number of desynchronizations (STATUS_ISSYNC, STATUS_MACSTATS)
+- radio duty cycle since the previous STATUS_MACSTATS
+- number of packet buffers in use (STATUS_QUEUE)
+- ERR_FLOOD_* codes printed over the last --window seconds
+
+Only the last value of each status element and one bucket of error counts per
+second are kept, so memory does not grow with the length of the run.
+
+Works with Python 2.7 and Python 3.
+'''
+
+import argparse
+import collections
+import os
+import sys
+import time
+
+import fastparser
+
+#============================ defines =========================================
+
+READ_SIZE       = 4096
+
+COMPONENT_NULL  = 0x00
+
+# ERR_FLOOD_* in inc/opendefs.h
+FLOOD_ERRCODES  = {
+    0x3c: 'send',
+    0x3d: 'rcv',
+    0x3e: 'fw',
+    0x40: 'state',
+    0x41: 'drop',
+    0x42: 'gen',
+}
+
+#============================ sources =========================================
+
+class FileSource(object):
+    '''
+    A capture file being written to.
+    '''
+
+    def __init__(self,filename,fromStart=False):
+        self.name = filename
+        self.f    = open(filename,'rb')
+        if not fromStart:
+            self.f.seek(0,os.SEEK_END)
+
+    def read(self):
+        data = self.f.read(READ_SIZE)
+        if not data and os.path.getsize(self.name)<self.f.tell():
+            # the capture was restarted
+            self.f.seek(0)
+            data = self.f.read(READ_SIZE)
+        return data
+
+class SerialSource(object):
+    '''
+    A serial port, read without blocking.
+    '''
+
+    def __init__(self,port,baudrate):
+        import serial
+        self.name = port
+        self.port = serial.Serial(port,baudrate,timeout=0)
+
+    def read(self):
+        return self.port.read(READ_SIZE)
+
+def openSource(name,baudrate,fromStart):
+    if name.startswith('/dev/') or name.upper().startswith('COM'):
+        return SerialSource(name,baudrate)
+    return FileSource(name,fromStart)
+
+#============================ metrics =========================================
+
+class MoteMetrics(object):
+    '''
+    Rolling metrics of one mote.
+    '''
+
+    def __init__(self,window):
+        self.window         = window
+        self.isSync         = None
+        self.numDeSync      = None
+        self.dutyCycle      = None
+        self.queueInUse     = None
+        self.queueLength    = None
+        self.lastTicsOn     = None
+        self.lastTicsTotal  = None
+        self.lastUpdate     = None
+        # one Counter of flood error codes per second
+        self.floodBuckets   = collections.deque()
+
+    def update(self,now,kind,d):
+        self.lastUpdate = now
+        if   kind=='status_isSync':
+            self.isSync = d['isSync']
+        elif kind=='status_macStats':
+            self.numDeSync = d['numDeSync']
+            if (
+                    self.lastTicsTotal is not None and
+                    d['numTicsTotal']>self.lastTicsTotal and
+                    d['numTicsOn']>=self.lastTicsOn
+                ):
+                self.dutyCycle = float(d['numTicsOn']-self.lastTicsOn)/(d['numTicsTotal']-self.lastTicsTotal)
+            elif d['numTicsTotal']>0:
+                # first report, or the counters were reset
+                self.dutyCycle = float(d['numTicsOn'])/d['numTicsTotal']
+            self.lastTicsOn    = d['numTicsOn']
+            self.lastTicsTotal = d['numTicsTotal']
+        elif kind=='status_queue':
+            self.queueLength = len(d)//2
+            self.queueInUse  = len([
+                i for i in range(self.queueLength) if d['owner{0}'.format(i)]!=COMPONENT_NULL
+            ])
+        elif kind=='error' and d['errcode'] in FLOOD_ERRCODES:
+            second = int(now)
+            if not self.floodBuckets or self.floodBuckets[-1][0]!=second:
+                self.floodBuckets.append((second,collections.Counter()))
+            self.floodBuckets[-1][1][FLOOD_ERRCODES[d['errcode']]] += 1
+        self.expire(now)
+
+    def expire(self,now):
+        while self.floodBuckets and self.floodBuckets[0][0]<=now-self.window:
+            self.floodBuckets.popleft()
+
+    def floodCounts(self):
+        total = collections.Counter()
+        for (_,counter) in self.floodBuckets:
+            total.update(counter)
+        return total
+
+class NetworkMetrics(object):
+    '''
+    Rolling metrics of all the motes, keyed by short address.
+    '''
+
+    def __init__(self,window):
+        self.window = window
+        self.motes  = {}
+
+    def update(self,now,record):
+        (_,_,kind,columns,values) = record
+        d = dict(zip(columns,values))
+        if 'src' not in d:
+            return
+        if d['src'] not in self.motes:
+            self.motes[d['src']] = MoteMetrics(self.window)
+        self.motes[d['src']].update(now,kind,d)
+
+    def format(self,now):
+        lines  = ['{0:>6} {1:>5} {2:>7} {3:>7} {4:>7} {5:>6}  {6}'.format(
+            'mote','sync','deSync','duty','queue','age','flood errors (last {0}s)'.format(self.window),
+        )]
+        for src in sorted(self.motes):
+            m = self.motes[src]
+            m.expire(now)
+            floods = m.floodCounts()
+            lines += ['{0:>6} {1:>5} {2:>7} {3:>7} {4:>7} {5:>6}  {6}'.format(
+                '{0:04x}'.format(src),
+                '-' if m.isSync is None else ('yes' if m.isSync else 'no'),
+                '-' if m.numDeSync is None else m.numDeSync,
+                '-' if m.dutyCycle is None else '{0:.2%}'.format(m.dutyCycle),
+                '-' if m.queueInUse is None else '{0}/{1}'.format(m.queueInUse,m.queueLength),
+                '{0:.1f}'.format(now-m.lastUpdate),
+                ' '.join(['{0}={1}'.format(k,floods[k]) for k in sorted(floods)]),
+            )]
+        return '\n'.join(lines)
+
+#============================ main ============================================
+
+def follow(sources,metrics,period,out=sys.stdout):
+    '''
+    Read the sources and print the metrics every period seconds, forever.
+    '''
+    parsers    = [fastparser.FrameParser() for _ in sources]
+    nextPrint  = time.time()+period
+    clear      = '\x1b[H\x1b[2J' if out.isatty() else ''
+    while True:
+        idle = True
+        for (source,parser) in zip(sources,parsers):
+            data = source.read()
+            if not data:
+                continue
+            idle = False
+            now  = time.time()
+            for record in parser.feed(data):
+                metrics.update(now,record)
+        now = time.time()
+        if now>=nextPrint:
+            out.write(clear+metrics.format(now)+'\n\n')
+            out.flush()
+            nextPrint = now+period
+        if idle:
+            time.sleep(min(0.05,period))
+
+def main():
+    argparser = argparse.ArgumentParser(description='Print rolling metrics of the motes from growing logs or serial ports.')
+    argparser.add_argument('sources',nargs='+',help='log files or serial ports')
+    argparser.add_argument('-b','--baudrate',type=int,default=115200,help='baudrate of the serial ports')
+    argparser.add_argument('-p','--period',type=float,default=0.5,help='seconds between two prints of the metrics')
+    argparser.add_argument('-w','--window',type=int,default=60,help='seconds over which errors are counted')
+    argparser.add_argument('--from-start',action='store_true',help='read the log files from their start rather than their end')
+    args = argparser.parse_args()
+
+    sources = [openSource(name,args.baudrate,args.from_start) for name in args.sources]
+    try:
+        follow(sources,NetworkMetrics(args.window),args.period)
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == "__main__":
+    main()
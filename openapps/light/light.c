@@ -12,18 +12,83 @@
 #include "sixtop.h"
 #include "debugpins.h"
 #include "openrandom.h"
+#include "energy.h"
 #include "leds.h"
 
 //=========================== variables =======================================
 
 light_vars_t        light_vars;
 
+static const uint16_t light_sensorIds[] = {SENSOR_IDS};
+
+#ifdef LIGHT_NETCODING
+// GF(2^8) with the 0x11d polynomial: powers of 2, and their logarithms
+static const uint8_t light_gfExp[255] = {
+   0x01,0x02,0x04,0x08,0x10,0x20,0x40,0x80,0x1d,0x3a,0x74,0xe8,0xcd,0x87,0x13,0x26,
+   0x4c,0x98,0x2d,0x5a,0xb4,0x75,0xea,0xc9,0x8f,0x03,0x06,0x0c,0x18,0x30,0x60,0xc0,
+   0x9d,0x27,0x4e,0x9c,0x25,0x4a,0x94,0x35,0x6a,0xd4,0xb5,0x77,0xee,0xc1,0x9f,0x23,
+   0x46,0x8c,0x05,0x0a,0x14,0x28,0x50,0xa0,0x5d,0xba,0x69,0xd2,0xb9,0x6f,0xde,0xa1,
+   0x5f,0xbe,0x61,0xc2,0x99,0x2f,0x5e,0xbc,0x65,0xca,0x89,0x0f,0x1e,0x3c,0x78,0xf0,
+   0xfd,0xe7,0xd3,0xbb,0x6b,0xd6,0xb1,0x7f,0xfe,0xe1,0xdf,0xa3,0x5b,0xb6,0x71,0xe2,
+   0xd9,0xaf,0x43,0x86,0x11,0x22,0x44,0x88,0x0d,0x1a,0x34,0x68,0xd0,0xbd,0x67,0xce,
+   0x81,0x1f,0x3e,0x7c,0xf8,0xed,0xc7,0x93,0x3b,0x76,0xec,0xc5,0x97,0x33,0x66,0xcc,
+   0x85,0x17,0x2e,0x5c,0xb8,0x6d,0xda,0xa9,0x4f,0x9e,0x21,0x42,0x84,0x15,0x2a,0x54,
+   0xa8,0x4d,0x9a,0x29,0x52,0xa4,0x55,0xaa,0x49,0x92,0x39,0x72,0xe4,0xd5,0xb7,0x73,
+   0xe6,0xd1,0xbf,0x63,0xc6,0x91,0x3f,0x7e,0xfc,0xe5,0xd7,0xb3,0x7b,0xf6,0xf1,0xff,
+   0xe3,0xdb,0xab,0x4b,0x96,0x31,0x62,0xc4,0x95,0x37,0x6e,0xdc,0xa5,0x57,0xae,0x41,
+   0x82,0x19,0x32,0x64,0xc8,0x8d,0x07,0x0e,0x1c,0x38,0x70,0xe0,0xdd,0xa7,0x53,0xa6,
+   0x51,0xa2,0x59,0xb2,0x79,0xf2,0xf9,0xef,0xc3,0x9b,0x2b,0x56,0xac,0x45,0x8a,0x09,
+   0x12,0x24,0x48,0x90,0x3d,0x7a,0xf4,0xf5,0xf7,0xf3,0xfb,0xeb,0xcb,0x8b,0x0b,0x16,
+   0x2c,0x58,0xb0,0x7d,0xfa,0xe9,0xcf,0x83,0x1b,0x36,0x6c,0xd8,0xad,0x47,0x8e
+};
+
+static const uint8_t light_gfLog[256] = {
+   0x00,0x00,0x01,0x19,0x02,0x32,0x1a,0xc6,0x03,0xdf,0x33,0xee,0x1b,0x68,0xc7,0x4b,
+   0x04,0x64,0xe0,0x0e,0x34,0x8d,0xef,0x81,0x1c,0xc1,0x69,0xf8,0xc8,0x08,0x4c,0x71,
+   0x05,0x8a,0x65,0x2f,0xe1,0x24,0x0f,0x21,0x35,0x93,0x8e,0xda,0xf0,0x12,0x82,0x45,
+   0x1d,0xb5,0xc2,0x7d,0x6a,0x27,0xf9,0xb9,0xc9,0x9a,0x09,0x78,0x4d,0xe4,0x72,0xa6,
+   0x06,0xbf,0x8b,0x62,0x66,0xdd,0x30,0xfd,0xe2,0x98,0x25,0xb3,0x10,0x91,0x22,0x88,
+   0x36,0xd0,0x94,0xce,0x8f,0x96,0xdb,0xbd,0xf1,0xd2,0x13,0x5c,0x83,0x38,0x46,0x40,
+   0x1e,0x42,0xb6,0xa3,0xc3,0x48,0x7e,0x6e,0x6b,0x3a,0x28,0x54,0xfa,0x85,0xba,0x3d,
+   0xca,0x5e,0x9b,0x9f,0x0a,0x15,0x79,0x2b,0x4e,0xd4,0xe5,0xac,0x73,0xf3,0xa7,0x57,
+   0x07,0x70,0xc0,0xf7,0x8c,0x80,0x63,0x0d,0x67,0x4a,0xde,0xed,0x31,0xc5,0xfe,0x18,
+   0xe3,0xa5,0x99,0x77,0x26,0xb8,0xb4,0x7c,0x11,0x44,0x92,0xd9,0x23,0x20,0x89,0x2e,
+   0x37,0x3f,0xd1,0x5b,0x95,0xbc,0xcf,0xcd,0x90,0x87,0x97,0xb2,0xdc,0xfc,0xbe,0x61,
+   0xf2,0x56,0xd3,0xab,0x14,0x2a,0x5d,0x9e,0x84,0x3c,0x39,0x53,0x47,0x6d,0x41,0xa2,
+   0x1f,0x2d,0x43,0xd8,0xb7,0x7b,0xa4,0x76,0xc4,0x17,0x49,0xec,0x7f,0x0c,0x6f,0xf6,
+   0x6c,0xa1,0x3b,0x52,0x29,0x9d,0x55,0xaa,0xfb,0x60,0x86,0xb1,0xbb,0xcc,0x3e,0x5a,
+   0xcb,0x59,0x5f,0xb0,0x9c,0xa9,0xa0,0x51,0x0b,0xf5,0x16,0xeb,0x7a,0x75,0x2c,0xd7,
+   0x4f,0xae,0xd5,0xe9,0xe6,0xe7,0xad,0xe8,0x74,0xd6,0xf4,0xea,0xa8,0x50,0x58,0xaf
+};
+#endif
+
 //=========================== prototypes =======================================
 
 void light_trigger_SENSOR(void);
 void light_trigger_NOT_SENSOR(void);
-void light_send_one_packet(uint8_t pktId);
-void light_update_light_state(uint8_t pkt_light_state);
+void light_send_one_packet(light_origin_t* o, uint8_t pktId);
+uint8_t light_get_light_info(light_origin_t* o, uint8_t pktId);
+bool light_isSensor(void);
+light_origin_t* light_getOrigin(uint16_t origin, uint8_t pkt_burstId);
+bool light_acceptBurst(light_origin_t* o, uint8_t pkt_burstId, uint8_t pkt_light_state);
+void light_update_light_state(light_origin_t* o, uint8_t pkt_light_state);
+void light_commit_light_state(bool light_state);
+void light_printTrace(light_origin_t* o, uint8_t pktId, asn_t* rxAsn);
+void light_sample_cb(opentimer_id_t id);
+void light_sample_task(void);
+bool light_getSample(uint16_t* reading);
+#ifdef LIGHT_NETCODING
+uint8_t light_gfMul(uint8_t a, uint8_t b);
+uint8_t light_gfInv(uint8_t a);
+void light_nc_addScaled(uint8_t* dst, uint8_t* src, uint8_t c);
+uint8_t light_nc_sensorIndex(uint16_t origin);
+light_nc_gen_t* light_nc_getGeneration(uint16_t generation);
+bool light_nc_addRow(light_nc_gen_t* g, uint8_t* row);
+void light_nc_deliver(light_nc_gen_t* g, asn_t* rxAsn);
+void light_nc_send(light_nc_gen_t* g);
+void light_nc_sendEvent(light_origin_t* o);
+void light_nc_receive(light_nc_ht* rxPkt, asn_t* rxAsn);
+#endif
 
 //=========================== public ===========================================
 
@@ -33,12 +98,32 @@ void light_update_light_state(uint8_t pkt_light_state);
 \brief Initialize this module.
 */
 void light_init(void) {
+   uint8_t i;
    
    // clear local variables
    memset(&light_vars,0,sizeof(light_vars_t));
+   for (i=0;i<LIGHT_MAX_ORIGINS;i++) {
+      light_vars.origins[i].origin        = LIGHT_ORIGIN_NONE;
+      light_vars.origins[i].tracedBurstId = LIGHT_BURSTID_NONE;
+   }
    
    debugpins_light_clr();
    leds_light_off();
+   
+#ifndef LIGHT_FAKESEND
+   // read the light sensor outside of the slot interrupt, only sensors need
+   // the readings: the other motes do not wake up for it
+   if (light_isSensor()) {
+      light_vars.sampleTimerId = opentimers_start(
+         LIGHT_SAMPLE_PERIOD_MS,
+         TIMER_PERIODIC,
+         TIME_MS,
+         light_sample_cb
+      );
+      // a sample a slot late is fine, read it on a slot wake-up
+      opentimers_setSlack(light_vars.sampleTimerId,TIME_TICS,TsSlotDuration);
+   }
+#endif
 }
 
 //=== transmitting
@@ -47,24 +132,30 @@ void light_init(void) {
 \brief Trigger the light app, which can decide to send a packet.
 */
 void light_trigger(slotOffset_t slotOffset) {
-   if ( idmanager_getMyShortID()==SENSOR_ID ) {
+   if (light_isSensor()) {
       light_trigger_SENSOR();
-   } else {
-      if (slotOffset==0) {
-         light_trigger_NOT_SENSOR();
-      }
+   }
+   if (slotOffset==0) {
+      light_trigger_NOT_SENSOR();
    }
 }
 
 void light_trigger_SENSOR(void) {
+   light_origin_t*      o;
    bool                 iShouldSend;
+#ifndef LIGHT_NETCODING
    uint8_t              pktId;
+#endif
 #ifdef LIGHT_FAKESEND
    uint16_t             numAsnSinceLastEvent;
-#else
-   callbackRead_cbt     light_read_cb;
 #endif
    
+   // my own flood state
+   o = light_getOrigin(idmanager_getMyShortID(),1);
+   if (o==NULL) {
+      return;
+   }
+   
 #ifdef LIGHT_FAKESEND
    // how many cells since the last time I transmitted?
    numAsnSinceLastEvent = ieee154e_asnDiff(&light_vars.lastEventAsn);
@@ -78,25 +169,24 @@ void light_trigger_SENSOR(void) {
       }
    }
 #else
-   // current light reading
-   light_read_cb             = sensors_getCallbackRead(SENSOR_LIGHT);
-   light_vars.light_reading  = light_read_cb();
+   // latest light reading, nothing to do if there is no new one
+   if (light_getSample(&light_vars.light_reading)==FALSE) {
+      return;
+   }
 #endif
    
    // detect light state switches
-   if (       light_vars.light_state==FALSE && (light_vars.light_reading >= (LUX_THRESHOLD + LUX_HYSTERESIS))) {
+   if (       o->light_state==FALSE && (light_vars.light_reading >= (LUX_THRESHOLD + LUX_HYSTERESIS))) {
       // light was just turned on
       
-      light_vars.light_state = TRUE;
-      debugpins_light_set();
-      leds_light_on();
+      o->light_state = TRUE;
+      light_commit_light_state(TRUE);
       iShouldSend = TRUE;
-   } else if (light_vars.light_state==TRUE  && (light_vars.light_reading <  (LUX_THRESHOLD - LUX_HYSTERESIS))) {
+   } else if (o->light_state==TRUE  && (light_vars.light_reading <  (LUX_THRESHOLD - LUX_HYSTERESIS))) {
       // light was just turned off
       
-      light_vars.light_state = FALSE;
-      debugpins_light_clr();
-      leds_light_off();
+      o->light_state = FALSE;
+      light_commit_light_state(FALSE);
       iShouldSend = TRUE;
    } else {
       // light stays in same state
@@ -115,42 +205,94 @@ void light_trigger_SENSOR(void) {
    ieee154e_getAsnStruct(&light_vars.lastEventAsn);
    
    // increment the burstId
-   light_vars.burstId = (light_vars.burstId+1)%16;
+   o->burstId  = (o->burstId+1)%16;
+   o->lastUsed = ++light_vars.useCounter;
    
+   // my EBs now advertise a new burst, send them faster
+   sixtop_resetEBTrickle();
+   
+   // the flood starts here
+   o->tracedBurstId   = o->burstId;
+   energy_newBurst(o->origin,o->burstId);
+   o->hops            = 0;
+   o->originAsn[0]    = (light_vars.lastEventAsn.bytes0and1     & 0xff);
+   o->originAsn[1]    = (light_vars.lastEventAsn.bytes0and1/256 & 0xff);
+   o->originAsn[2]    = (light_vars.lastEventAsn.bytes2and3     & 0xff);
+   o->originAsn[3]    = (light_vars.lastEventAsn.bytes2and3/256 & 0xff);
+   light_printTrace(o,0,&light_vars.lastEventAsn);
+   
+#ifdef LIGHT_NETCODING
+   light_nc_sendEvent(o);
+#else
    // send burst of LIGHT_BURSTSIZE packets
    for (pktId=0;pktId<LIGHT_BURSTSIZE;pktId++) {
-      light_send_one_packet(pktId);
+      light_send_one_packet(o,pktId);
    }
+#endif
 }
 
 void light_trigger_NOT_SENSOR(void) {
-   if (light_vars.numMissedBursts>0) {
+   light_origin_t*      o;
+   uint8_t              i;
+   
+   for (i=0;i<LIGHT_MAX_ORIGINS;i++) {
+      o = &light_vars.origins[i];
+      if (o->origin==LIGHT_ORIGIN_NONE || o->numMissedBursts==0) {
+         continue;
+      }
+      
       // toggle the light state
-      if (light_vars.light_state==1) {
-         light_vars.light_state = 0;
+      if (o->light_state==1) {
+         o->light_state = 0;
       } else {
-         light_vars.light_state = 1;
+         o->light_state = 1;
       }
       
       // commit to the light led and pin
-      if (light_vars.light_state==TRUE) {
-         debugpins_light_set();
-         leds_light_on();
-      } else {
-         debugpins_light_clr();
-         leds_light_off();
-      }
+      light_commit_light_state(o->light_state);
       
       // decrement numMissedBursts
-      light_vars.numMissedBursts--;
+      o->numMissedBursts--;
    }
 }
 
-uint8_t  light_get_light_info(uint8_t pktId) {
-   return (light_vars.burstId<<4) | (pktId<<1) | light_vars.light_state;
+/**
+\brief Write the latest burst of some of the origins, for an EB.
+
+Successive EBs go round the table of origins, so all of them are advertised
+even though an EB only has room for LIGHT_DIGEST_NUMENTRIES.
+
+\param[out] digest Where to write the digest, LIGHT_DIGEST_LENGTH bytes.
+*/
+void light_getDigest(uint8_t* digest) {
+   light_digest_t*      entry;
+   light_origin_t*      o;
+   uint8_t              numEntries;
+   uint8_t              i;
+   
+   entry      = (light_digest_t*)digest;
+   numEntries = 0;
+   for (i=0;i<LIGHT_MAX_ORIGINS && numEntries<LIGHT_DIGEST_NUMENTRIES;i++) {
+      o                    = &light_vars.origins[light_vars.digestIdx];
+      light_vars.digestIdx = (light_vars.digestIdx+1)%LIGHT_MAX_ORIGINS;
+      if (o->origin==LIGHT_ORIGIN_NONE) {
+         continue;
+      }
+      entry[numEntries].origin     = o->origin;
+      entry[numEntries].light_info = light_get_light_info(o,0);
+      numEntries++;
+   }
+   for (;numEntries<LIGHT_DIGEST_NUMENTRIES;numEntries++) {
+      entry[numEntries].origin     = LIGHT_ORIGIN_NONE;
+      entry[numEntries].light_info = 0;
+   }
 }
 
-port_INLINE void light_send_one_packet(uint8_t pktId) {
+uint8_t  light_get_light_info(light_origin_t* o, uint8_t pktId) {
+   return (o->burstId<<4) | (pktId<<1) | o->light_state;
+}
+
+port_INLINE void light_send_one_packet(light_origin_t* o, uint8_t pktId) {
    OpenQueueEntry_t*    pkt;
    
    // get a free packet buffer
@@ -168,7 +310,13 @@ port_INLINE void light_send_one_packet(uint8_t pktId) {
    packetfunctions_reserveHeaderSize(pkt,sizeof(light_ht));
    ((light_ht*)(pkt->payload))->type        = LONGTYPE_DATA;
    ((light_ht*)(pkt->payload))->src         = idmanager_getMyShortID();
-   ((light_ht*)(pkt->payload))->light_info  = light_get_light_info(pktId);
+   ((light_ht*)(pkt->payload))->light_info  = light_get_light_info(o,pktId);
+   ((light_ht*)(pkt->payload))->origin      = o->origin;
+   ((light_ht*)(pkt->payload))->hops        = o->hops;
+   ((light_ht*)(pkt->payload))->asn0        = o->originAsn[0];
+   ((light_ht*)(pkt->payload))->asn1        = o->originAsn[1];
+   ((light_ht*)(pkt->payload))->asn2        = o->originAsn[2];
+   ((light_ht*)(pkt->payload))->asn3        = o->originAsn[3];
    
    // send
    if ((sixtop_send(pkt))==E_FAIL) {
@@ -187,66 +335,57 @@ void light_sendDone(OpenQueueEntry_t* msg, owerror_t error) {
 
 void light_receive_beacon(OpenQueueEntry_t* pkt) {
    eb_ht*          rxPkt;
+   light_digest_t* entry;
+   light_origin_t* o;
    uint8_t         pkt_burstId;
    uint8_t         pkt_light_state;
+   uint8_t         i;
    
-   // handle the packet
-   do {
+   // take ownserhip over the packet
+   pkt->owner        = COMPONENT_LIGHT;
+   
+   // parse packet
+   rxPkt             = (eb_ht*)pkt->payload;
+   entry             = (light_digest_t*)rxPkt->light_digest;
+   
+   for (i=0;i<LIGHT_DIGEST_NUMENTRIES;i++) {
       
-      // abort if I'm the sensor
-      if ( idmanager_getMyShortID()==SENSOR_ID ) {
-         break;
+      // skip unused entries and my own floods
+      if (
+            entry[i].origin==LIGHT_ORIGIN_NONE ||
+            entry[i].origin==idmanager_getMyShortID()
+         ) {
+         continue;
       }
-     
-      // take ownserhip over the packet
-      pkt->owner        = COMPONENT_LIGHT;
       
-      // parse packet
-      rxPkt             = (eb_ht*)pkt->payload;
-      pkt_burstId       = (rxPkt->light_info & 0xf0)>>4;
-      pkt_light_state   = (rxPkt->light_info & 0x01)>>0;
-      
-      // filter burstID
-      if (pkt_burstId!=light_vars.burstId) {
-         if ( ((pkt_burstId-light_vars.burstId)&0x0f) <=7) {
-            // new burstID
-            
-            // reset pktIDMap
-            light_vars.pktIDMap = 0x00;
-            
-            // remove old packets from queue
-            // TODO Fix #17
-            
-         } else {
-            // old burstID
-            
-            // abort
-            break;
-         }
-      }
+      pkt_burstId       = (entry[i].light_info & 0xf0)>>4;
+      pkt_light_state   = (entry[i].light_info & 0x01)>>0;
       
-      // record the number of missed bursts, if any
-      if (light_vars.burstId!=pkt_burstId) {
-         while (light_vars.burstId!=pkt_burstId) {
-            light_vars.burstId = (light_vars.burstId+1)%16;
-            light_vars.numMissedBursts++;
-         }
-         light_vars.numMissedBursts--;
-         
-         // update the light state
-         light_update_light_state(pkt_light_state);
+      o = light_getOrigin(entry[i].origin,pkt_burstId);
+      if (o==NULL) {
+         continue;
       }
       
-      //=== if I get here, light_vars.burstId==pkt_burstId
-      
-   } while(0);
+      // catch up on the burst, if it is a new one
+      light_acceptBurst(o,pkt_burstId,pkt_light_state);
+   }
    
    // free packet
    openqueue_freePacketBuffer(pkt);
 }
 
 void light_receive_data(OpenQueueEntry_t* pkt) {
+#ifdef LIGHT_NETCODING
+   if (ieee154e_isSynch()==TRUE) {
+      pkt->owner = COMPONENT_LIGHT;
+      light_nc_receive((light_nc_ht*)pkt->payload,&pkt->l2_asn);
+   }
+   
+   // free the packet
+   openqueue_freePacketBuffer(pkt);
+#else
    light_ht*         rxPkt;
+   light_origin_t*   o;
    uint8_t           pkt_burstId;
    uint8_t           pkt_pktId;
    uint8_t           pkt_light_state;
@@ -258,99 +397,206 @@ void light_receive_data(OpenQueueEntry_t* pkt) {
          break;
       }
       
-      // abort if I'm the SENSOR node
-      if (idmanager_getMyShortID()==SENSOR_ID) {
-         break;
-      }
-      
       // take ownserhip over the packet
       pkt->owner = COMPONENT_LIGHT;
       
       // parse packet
       rxPkt             = (light_ht*)pkt->payload;
       pkt_burstId       = (rxPkt->light_info & 0xf0)>>4;
-      pkt_pktId         = (rxPkt->light_info & 0x07)>>1;
+      pkt_pktId         = (rxPkt->light_info & 0x0e)>>1;
       pkt_light_state   = (rxPkt->light_info & 0x01)>>0;
       
-      // filter burstID
-      if (pkt_burstId!=light_vars.burstId) {
-         if ( ((pkt_burstId-light_vars.burstId)&0x0f) <=7) {
-            // new burstID
-            
-            // reset pktIDMap
-            light_vars.pktIDMap = 0x00;
-            
-            // remove old packets from queue
-            // TODO Fix #17
-            
-         } else {
-            // old burstID
-            
-            // abort
-            break;
-         }
+      // abort if this is my own flood
+      if (rxPkt->origin==idmanager_getMyShortID()) {
+         break;
+      }
+      
+      // find the flood state of that sensor
+      o = light_getOrigin(rxPkt->origin,pkt_burstId);
+      if (o==NULL) {
+         break;
+      }
+      
+      // abort if this is an old burst
+      if (light_acceptBurst(o,pkt_burstId,pkt_light_state)==FALSE) {
+         break;
+      }
+      
+      //=== if I get here, o->burstId==pkt_burstId
+      
+      // log the first reception of this burst
+      if (pkt_burstId!=o->tracedBurstId) {
+         o->tracedBurstId   = pkt_burstId;
+         energy_newBurst(o->origin,pkt_burstId);
+         o->hops            = rxPkt->hops+1;
+         o->originAsn[0]    = rxPkt->asn0;
+         o->originAsn[1]    = rxPkt->asn1;
+         o->originAsn[2]    = rxPkt->asn2;
+         o->originAsn[3]    = rxPkt->asn3;
+         light_printTrace(o,pkt_pktId,&pkt->l2_asn);
       }
       
       // abort if this is a pktId I already sent
-      if ( light_vars.pktIDMap & (1<<pkt_pktId) ) {
+      if ( o->pktIDMap & (1<<pkt_pktId) ) {
           // already sent
           break;
       } else {
           // remember I sent that one
-          light_vars.pktIDMap |= (1<<pkt_pktId);
+          o->pktIDMap |= (1<<pkt_pktId);
       }
       
       //== if I get here, I accept the data packet
       
-      if (light_vars.burstId!=pkt_burstId) {
-         
-        // record number of missed bursts
-        while (light_vars.burstId!=pkt_burstId) {
-            light_vars.burstId = (light_vars.burstId+1)%16;
-            light_vars.numMissedBursts++;
-         }
-         light_vars.numMissedBursts--;
-         
-         // update the light state
-         light_update_light_state(pkt_light_state);
-      }
-      
-      //=== if I get here, light_vars.burstId==pkt_burstId
-      
       // retransmit packet
       if (idmanager_getMyShortID()!=SINK_ID) {
-         light_send_one_packet(pkt_pktId);
+         light_send_one_packet(o,pkt_pktId);
       }
    } while(0);
    
    // free the packet
    openqueue_freePacketBuffer(pkt);
+#endif
 }
 
 //=========================== private ==========================================
 
-void light_update_light_state(uint8_t pkt_light_state) {
+bool light_isSensor(void) {
+   uint8_t i;
+   
+   for (i=0;i<sizeof(light_sensorIds)/sizeof(light_sensorIds[0]);i++) {
+      if (light_sensorIds[i]==idmanager_getMyShortID()) {
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/**
+\brief Find the flood state of a sensor, allocating it if needed.
+
+When the table is full, the entry of the sensor whose last burst is the oldest
+is reused; my own entry is never reused.
+
+\param[in] origin      The short ID of the sensor.
+\param[in] pkt_burstId The burst just heard of, which a new entry takes as the
+   next one so it is accepted without counting missed bursts.
+
+\returns The entry, or NULL if none can be reused.
+*/
+light_origin_t* light_getOrigin(uint16_t origin, uint8_t pkt_burstId) {
+   light_origin_t*      o;
+   light_origin_t*      oldest;
+   uint8_t              i;
+   
+   oldest = NULL;
+   for (i=0;i<LIGHT_MAX_ORIGINS;i++) {
+      o = &light_vars.origins[i];
+      if (o->origin==origin) {
+         return o;
+      }
+      if (o->origin==LIGHT_ORIGIN_NONE) {
+         if (oldest==NULL || oldest->origin!=LIGHT_ORIGIN_NONE) {
+            oldest = o;
+         }
+      } else if (
+            o->origin!=idmanager_getMyShortID() &&
+            (
+               oldest==NULL ||
+               (
+                  oldest->origin!=LIGHT_ORIGIN_NONE &&
+                  (uint16_t)(light_vars.useCounter-o->lastUsed)>(uint16_t)(light_vars.useCounter-oldest->lastUsed)
+               )
+            )
+         ) {
+         oldest = o;
+      }
+   }
+   if (oldest==NULL) {
+      return NULL;
+   }
+   
+   memset(oldest,0,sizeof(light_origin_t));
+   oldest->origin          = origin;
+   oldest->burstId         = (pkt_burstId-1)&0x0f;
+   oldest->tracedBurstId   = LIGHT_BURSTID_NONE;
+   oldest->lastUsed        = light_vars.useCounter;
+   return oldest;
+}
+
+/**
+\brief Filter a burst heard of and catch up on the light state if it is new.
+
+\returns FALSE if the burst is older than the current one of that sensor.
+*/
+bool light_acceptBurst(light_origin_t* o, uint8_t pkt_burstId, uint8_t pkt_light_state) {
+   
+   // filter burstID
+   if (pkt_burstId!=o->burstId) {
+      if ( ((pkt_burstId-o->burstId)&0x0f) <=7) {
+         // new burstID
+         
+         // reset pktIDMap
+         o->pktIDMap = 0x00;
+         
+         // remove old packets from queue
+         // TODO Fix #17
+      
+      } else {
+         // old burstID
+         
+         return FALSE;
+      }
+   }
+   
+   // record the number of missed bursts, if any
+   if (o->burstId!=pkt_burstId) {
+      while (o->burstId!=pkt_burstId) {
+         o->burstId = (o->burstId+1)%16;
+         o->numMissedBursts++;
+      }
+      o->numMissedBursts--;
+      o->lastUsed = ++light_vars.useCounter;
+      
+      // my EBs now advertise a new burst, send them faster
+      sixtop_resetEBTrickle();
+      
+      // update the light state
+      light_update_light_state(o,pkt_light_state);
+   }
+   
+   return TRUE;
+}
+
+void light_update_light_state(light_origin_t* o, uint8_t pkt_light_state) {
    
    // change the state
-   if (light_vars.numMissedBursts==0) {
+   if (o->numMissedBursts==0) {
       // we have NOT missed any bursts
-     
-      // apply the state from the packet
-      light_vars.light_state = pkt_light_state;
       
+      // apply the state from the packet
+      o->light_state = pkt_light_state;
+   
    } else {
       // we have missed at least one burst
-     
+      
       // toggle the state, regardless of the state in the packet
-      if (light_vars.light_state==1) {
-         light_vars.light_state = 0;
+      if (o->light_state==1) {
+         o->light_state = 0;
       } else {
-         light_vars.light_state = 1;
+         o->light_state = 1;
       }
    }
    
    // commit to the light led and pin
-   if (light_vars.light_state==TRUE) {
+   light_commit_light_state(o->light_state);
+}
+
+/**
+\brief Show a light state on the light led and pin; the latest burst of any
+   sensor wins.
+*/
+void light_commit_light_state(bool light_state) {
+   if (light_state==TRUE) {
       debugpins_light_set();
       leds_light_on();
    } else {
@@ -358,3 +604,394 @@ void light_update_light_state(uint8_t pkt_light_state) {
       leds_light_off();
    }
 }
+
+//=== network coding
+
+#ifdef LIGHT_NETCODING
+
+/**
+\brief Multiply two elements of GF(2^8).
+*/
+port_INLINE uint8_t light_gfMul(uint8_t a, uint8_t b) {
+   if (a==0 || b==0) {
+      return 0;
+   }
+   return light_gfExp[(light_gfLog[a]+light_gfLog[b])%255];
+}
+
+/**
+\brief Multiplicative inverse of a non-zero element of GF(2^8).
+*/
+port_INLINE uint8_t light_gfInv(uint8_t a) {
+   return light_gfExp[(255-light_gfLog[a])%255];
+}
+
+/**
+\brief Add c times src to dst, over GF(2^8).
+*/
+void light_nc_addScaled(uint8_t* dst, uint8_t* src, uint8_t c) {
+   uint8_t i;
+   
+   if (c==0) {
+      return;
+   }
+   for (i=0;i<LIGHT_NC_ROW_LENGTH;i++) {
+      dst[i] ^= light_gfMul(c,src[i]);
+   }
+}
+
+/**
+\brief Index of a sensor in SENSOR_IDS, if its events can be coded.
+
+\returns The index, or LIGHT_NC_MAXSYMBOLS if the events of that mote are
+   not coded.
+*/
+uint8_t light_nc_sensorIndex(uint16_t origin) {
+   uint8_t i;
+   
+   for (i=0;i<sizeof(light_sensorIds)/sizeof(light_sensorIds[0]) && i<LIGHT_NC_MAXSYMBOLS;i++) {
+      if (light_sensorIds[i]==origin) {
+         return i;
+      }
+   }
+   return LIGHT_NC_MAXSYMBOLS;
+}
+
+/**
+\brief Find the decoder of a window, reusing the oldest one if needed.
+
+\returns The decoder, or NULL if the window is older than all the ones being
+   decoded.
+*/
+light_nc_gen_t* light_nc_getGeneration(uint16_t generation) {
+   light_nc_gen_t*      g;
+   light_nc_gen_t*      oldest;
+   uint8_t              i;
+   
+   oldest = NULL;
+   for (i=0;i<LIGHT_NC_NUMGENERATIONS;i++) {
+      g = &light_vars.generations[i];
+      if (g->used==TRUE && g->generation==generation) {
+         return g;
+      }
+      if (g->used==FALSE) {
+         oldest = g;
+      } else if (
+            (oldest==NULL || oldest->used==TRUE)  &&
+            (int16_t)(generation-g->generation)>0 &&
+            (oldest==NULL || (int16_t)(oldest->generation-g->generation)>0)
+         ) {
+         oldest = g;
+      }
+   }
+   if (oldest==NULL) {
+      return NULL;
+   }
+   
+   memset(oldest,0,sizeof(light_nc_gen_t));
+   oldest->used         = TRUE;
+   oldest->generation   = generation;
+   oldest->hops         = LIGHT_NC_HOPS_NONE;
+   return oldest;
+}
+
+/**
+\brief Add a combination to a decoder, by Gauss-Jordan elimination.
+
+\returns TRUE if the combination was innovative, i.e. increased the rank.
+*/
+bool light_nc_addRow(light_nc_gen_t* g, uint8_t* row) {
+   uint8_t              pivot;
+   uint8_t              inv;
+   uint8_t              i;
+   
+   // eliminate the columns which already have a pivot
+   for (i=0;i<LIGHT_NC_MAXSYMBOLS;i++) {
+      if (row[i]!=0 && g->rows[i][i]!=0) {
+         light_nc_addScaled(row,g->rows[i],row[i]);
+      }
+   }
+   
+   // find the pivot of what is left
+   for (pivot=0;pivot<LIGHT_NC_MAXSYMBOLS && row[pivot]==0;pivot++);
+   if (pivot==LIGHT_NC_MAXSYMBOLS) {
+      return FALSE;
+   }
+   
+   // normalize it, and eliminate its column from the other rows
+   inv = light_gfInv(row[pivot]);
+   for (i=0;i<LIGHT_NC_ROW_LENGTH;i++) {
+      row[i] = light_gfMul(row[i],inv);
+   }
+   for (i=0;i<LIGHT_NC_MAXSYMBOLS;i++) {
+      if (g->rows[i][i]!=0 && g->rows[i][pivot]!=0) {
+         light_nc_addScaled(g->rows[i],row,g->rows[i][pivot]);
+      }
+   }
+   memcpy(g->rows[pivot],row,LIGHT_NC_ROW_LENGTH);
+   g->rank++;
+   
+   return TRUE;
+}
+
+/**
+\brief Apply the events a decoder just decoded.
+*/
+void light_nc_deliver(light_nc_gen_t* g, asn_t* rxAsn) {
+   light_origin_t*      o;
+   uint8_t*             row;
+   uint8_t              pkt_burstId;
+   uint8_t              pkt_light_state;
+   uint8_t              i;
+   uint8_t              j;
+   
+   for (i=0;i<LIGHT_NC_MAXSYMBOLS;i++) {
+      row = g->rows[i];
+      if (row[i]==0 || (g->delivered & (1<<i))) {
+         continue;
+      }
+      for (j=0;j<LIGHT_NC_MAXSYMBOLS && (j==i || row[j]==0);j++);
+      if (j<LIGHT_NC_MAXSYMBOLS) {
+         // still combined with other events
+         continue;
+      }
+      g->delivered |= (1<<i);
+      
+      // skip my own event, and garbage
+      if (
+            i>=sizeof(light_sensorIds)/sizeof(light_sensorIds[0]) ||
+            light_sensorIds[i]==idmanager_getMyShortID()
+         ) {
+         continue;
+      }
+      
+      pkt_burstId       = (row[LIGHT_NC_MAXSYMBOLS] & 0xf0)>>4;
+      pkt_light_state   = (row[LIGHT_NC_MAXSYMBOLS] & 0x01)>>0;
+      
+      o = light_getOrigin(light_sensorIds[i],pkt_burstId);
+      if (o==NULL || light_acceptBurst(o,pkt_burstId,pkt_light_state)==FALSE) {
+         continue;
+      }
+      
+      // log the first reception of this burst
+      if (pkt_burstId!=o->tracedBurstId) {
+         o->tracedBurstId   = pkt_burstId;
+         energy_newBurst(o->origin,pkt_burstId);
+         o->hops            = g->hops;
+         memcpy(o->originAsn,&row[LIGHT_NC_MAXSYMBOLS+1],sizeof(o->originAsn));
+         light_printTrace(o,0,rxAsn);
+      }
+   }
+}
+
+/**
+\brief Send a random combination of all the rows of a decoder.
+*/
+void light_nc_send(light_nc_gen_t* g) {
+   OpenQueueEntry_t*    pkt;
+   light_nc_ht*         txPkt;
+   uint8_t              row[LIGHT_NC_ROW_LENGTH];
+   uint8_t              c;
+   uint8_t              i;
+   
+   // combine
+   memset(row,0,sizeof(row));
+   for (i=0;i<LIGHT_NC_MAXSYMBOLS;i++) {
+      if (g->rows[i][i]==0) {
+         continue;
+      }
+      c = (uint8_t)openrandom_get16b();
+      if (c==0) {
+         c = 1;
+      }
+      light_nc_addScaled(row,g->rows[i],c);
+   }
+   
+   // get a free packet buffer
+   pkt = openqueue_getFreePacketBuffer(COMPONENT_LIGHT);
+   if (pkt==NULL) {
+      openserial_printError(COMPONENT_LIGHT,ERR_NO_FREE_PACKET_BUFFER,0,0);
+      return;
+   }
+   
+   // take ownership over the packet
+   pkt->owner                   = COMPONENT_LIGHT;
+   pkt->creator                 = COMPONENT_LIGHT;
+   
+   // fill payload
+   packetfunctions_reserveHeaderSize(pkt,sizeof(light_nc_ht));
+   txPkt                        = (light_nc_ht*)(pkt->payload);
+   txPkt->type                  = LONGTYPE_DATA;
+   txPkt->src                   = idmanager_getMyShortID();
+   txPkt->hops                  = g->hops;
+   txPkt->generation            = g->generation;
+   memcpy(txPkt->coefs,  &row[0],                  LIGHT_NC_MAXSYMBOLS);
+   memcpy(txPkt->payload,&row[LIGHT_NC_MAXSYMBOLS],LIGHT_NC_SYMBOL_LENGTH);
+   
+   // send
+   if ((sixtop_send(pkt))==E_FAIL) {
+      openqueue_freePacketBuffer(pkt);
+   }
+}
+
+/**
+\brief Start the flood of my own event.
+
+The event goes in the window of its ASN or, if I already had an event in that
+window, in the next one.
+*/
+void light_nc_sendEvent(light_origin_t* o) {
+   light_nc_gen_t*      g;
+   uint8_t              row[LIGHT_NC_ROW_LENGTH];
+   uint16_t             generation;
+   uint8_t              idx;
+   uint8_t              pktId;
+   uint8_t              i;
+   
+   idx = light_nc_sensorIndex(o->origin);
+   if (idx==LIGHT_NC_MAXSYMBOLS) {
+      return;
+   }
+   
+   generation = (uint16_t)(
+      (
+         ((uint32_t)o->originAsn[3]<<24) |
+         ((uint32_t)o->originAsn[2]<<16) |
+         ((uint32_t)o->originAsn[1]<< 8) |
+         ((uint32_t)o->originAsn[0]<< 0)
+      )/LIGHT_NC_WINDOW
+   );
+   g = NULL;
+   for (i=0;i<LIGHT_NC_NUMGENERATIONS;i++,generation++) {
+      g = light_nc_getGeneration(generation);
+      if (g!=NULL && g->rows[idx][idx]==0) {
+         break;
+      }
+      g = NULL;
+   }
+   if (g==NULL) {
+      return;
+   }
+   
+   // my event, on its own
+   memset(row,0,sizeof(row));
+   row[idx]                     = 1;
+   row[LIGHT_NC_MAXSYMBOLS]     = light_get_light_info(o,0);
+   memcpy(&row[LIGHT_NC_MAXSYMBOLS+1],o->originAsn,sizeof(o->originAsn));
+   light_nc_addRow(g,row);
+   g->delivered                |= (1<<idx);
+   g->hops                      = 0;
+   
+   // send burst of LIGHT_BURSTSIZE combinations
+   for (pktId=0;pktId<LIGHT_BURSTSIZE;pktId++) {
+      light_nc_send(g);
+   }
+}
+
+/**
+\brief Handle a coded data packet.
+*/
+void light_nc_receive(light_nc_ht* rxPkt, asn_t* rxAsn) {
+   light_nc_gen_t*      g;
+   uint8_t              row[LIGHT_NC_ROW_LENGTH];
+   uint8_t              i;
+   
+   g = light_nc_getGeneration(rxPkt->generation);
+   if (g==NULL) {
+      return;
+   }
+   
+   if (rxPkt->hops!=LIGHT_NC_HOPS_NONE && rxPkt->hops+1<g->hops) {
+      g->hops = rxPkt->hops+1;
+   }
+   
+   memcpy(&row[0],                  rxPkt->coefs,  LIGHT_NC_MAXSYMBOLS);
+   memcpy(&row[LIGHT_NC_MAXSYMBOLS],rxPkt->payload,LIGHT_NC_SYMBOL_LENGTH);
+   if (light_nc_addRow(g,row)==FALSE) {
+      // nothing new
+      return;
+   }
+   
+   light_nc_deliver(g,rxAsn);
+   
+   // recode and forward
+   if (idmanager_getMyShortID()!=SINK_ID) {
+      for (i=0;i<LIGHT_NC_REDUNDANCY;i++) {
+         light_nc_send(g);
+      }
+   }
+}
+
+#endif
+
+//=== sampling
+
+void light_sample_cb(opentimer_id_t id) {
+   scheduler_push_task(light_sample_task,TASKPRIO_LIGHT_SAMPLE);
+}
+
+/**
+\brief Read the light sensor and publish the sample.
+
+Runs as a task, as reading the sensor can take longer than a slot (an I2C
+transaction on the OpenMote).
+*/
+void light_sample_task(void) {
+   callbackRead_cbt     light_read_cb;
+   uint8_t              next;
+   
+   light_read_cb = sensors_getCallbackRead(SENSOR_LIGHT);
+   if (light_read_cb==NULL) {
+      return;
+   }
+   
+   // write the buffer the slot interrupt does not read
+   next                             = 1-light_vars.sample.idx;
+   light_vars.sample.reading[next]  = light_read_cb();
+   
+   // publish it
+   light_vars.sample.idx            = next;
+   light_vars.sample.seq++;
+}
+
+/**
+\brief Get the latest sample, called from the slot interrupt.
+
+\param[out] reading The latest sample.
+
+\returns TRUE if there is a sample which was not read yet, FALSE otherwise, in
+   which case reading is left untouched.
+*/
+port_INLINE bool light_getSample(uint16_t* reading) {
+   if (light_vars.sample.seq==light_vars.sampleSeqRead) {
+      return FALSE;
+   }
+   light_vars.sampleSeqRead = light_vars.sample.seq;
+   *reading                 = light_vars.sample.reading[light_vars.sample.idx];
+   return TRUE;
+}
+
+/**
+\brief Log the first reception of the current burst, for the PC to compute
+   the latency of the flood.
+
+\param[in] o     The flood state of the sensor.
+\param[in] pktId The first packet of the burst received.
+\param[in] rxAsn The ASN it was received at.
+*/
+void light_printTrace(light_origin_t* o, uint8_t pktId, asn_t* rxAsn) {
+   light_trace_t trace;
+   
+   trace.marker       = LIGHT_TRACE_MARKER;
+   trace.origin       = o->origin;
+   trace.burstId      = o->tracedBurstId;
+   trace.pktId        = pktId;
+   trace.hops         = o->hops;
+   memcpy(trace.originAsn,o->originAsn,sizeof(trace.originAsn));
+   trace.rxAsn[0]     = (rxAsn->bytes0and1     & 0xff);
+   trace.rxAsn[1]     = (rxAsn->bytes0and1/256 & 0xff);
+   trace.rxAsn[2]     = (rxAsn->bytes2and3     & 0xff);
+   trace.rxAsn[3]     = (rxAsn->bytes2and3/256 & 0xff);
+   
+   openserial_printData((uint8_t*)&trace,sizeof(light_trace_t));
+}
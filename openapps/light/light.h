@@ -11,29 +11,52 @@
 #define LIGHT_BURSTSIZE             5 // number of packets sent on each light event
 #define LUX_THRESHOLD             400
 #define LUX_HYSTERESIS            100
+#define LIGHT_TRACE_MARKER       0x4c // first byte of the DATA frames tracing the flood ('L')
+#define LIGHT_BURSTID_NONE       0xff // no burst traced yet
+#define LIGHT_ORIGIN_NONE      0x0000 // free entry of the origin table
+#define LIGHT_MAX_ORIGINS          16 // number of sensors whose floods are tracked at once
+#define LIGHT_DIGEST_NUMENTRIES     2 // number of origins advertised in each EB
+
+//=== network coding (LIGHT_NETCODING)
+
+#ifndef LIGHT_NC_MAXSYMBOLS
+#define LIGHT_NC_MAXSYMBOLS         8 // sensors coded together, the first ones of SENSOR_IDS; at most 8
+#endif
+#define LIGHT_NC_SYMBOL_LENGTH      5 // light_info and ASN of the event
+#define LIGHT_NC_ROW_LENGTH       (LIGHT_NC_MAXSYMBOLS+LIGHT_NC_SYMBOL_LENGTH)
+#define LIGHT_NC_WINDOW            64 // slots; events whose ASN falls in the same window are coded together
+#define LIGHT_NC_NUMGENERATIONS     2 // number of windows decoded at once
+#define LIGHT_NC_REDUNDANCY         2 // coded packets a relay sends for each innovative packet it receives
+#define LIGHT_NC_HOPS_NONE       0xff
+
+#ifndef LIGHT_SAMPLE_PERIOD_MS
+#define LIGHT_SAMPLE_PERIOD_MS     20 // period, in ms, of reading the light sensor
+#endif
 
 //=== hardcoded addresses (last 2 bytes of the EUI64)
 
 /*
 // Pedro@USC
 #define SINK_ID                   0xed4e
-#define SENSOR_ID                 0x89a5
+#define SENSOR_IDS                0x89a5
 // Thomas@Inria
 #define SINK_ID                   0x6f16
-#define SENSOR_ID                 0xb957
+#define SENSOR_IDS                0xb957
 // Thomas@home
 #define SINK_ID                   0xbb5e
-#define SENSOR_ID                 0x930f
+#define SENSOR_IDS                0x930f
 */
 
+// SENSOR_IDS is a comma-separated list, every mote in it floods its light events
+
 #ifdef SETUP_USBHUB
 #define SINK_ID                   0x6f16
-#define SENSOR_ID                 0xb957
+#define SENSOR_IDS                0xb957
 #endif
 
 #ifdef SETUP_TESTBED
 #define SINK_ID                   0x76fb
-#define SENSOR_ID                 0x86a0
+#define SENSOR_IDS                0x86a0
 #endif
 
 //=========================== typedef ==========================================
@@ -44,21 +67,112 @@ typedef struct {                            // always written big endian, i.e. M
    uint16_t  src;
    uint8_t   syncnum;
    uint8_t   light_info;
+   uint16_t  origin;                        // short ID of the sensor which generated the burst
+   uint8_t   hops;                          // hops from the sensor to the sender
+   uint8_t   asn0;                          // ASN of the light event, least significant byte first
+   uint8_t   asn1;
+   uint8_t   asn2;
+   uint8_t   asn3;
 } light_ht;
 END_PACK
 
+BEGIN_PACK
+typedef struct {                            // data packet, with LIGHT_NETCODING
+   uint16_t  type;
+   uint16_t  src;
+   uint8_t   syncnum;
+   uint8_t   hops;                          // hops from the closest sensor of the generation to the sender
+   uint16_t  generation;                    // window of the events coded together
+   uint8_t   coefs[LIGHT_NC_MAXSYMBOLS];    // coefficient of the event of each sensor, over GF(2^8)
+   uint8_t   payload[LIGHT_NC_SYMBOL_LENGTH]; // the same combination of the events
+} light_nc_ht;
+END_PACK
+
+BEGIN_PACK
+typedef struct {                            // printed as a DATA frame at the first reception of a burst
+   uint8_t   marker;                        // LIGHT_TRACE_MARKER
+   uint16_t  origin;                        // short ID of the sensor
+   uint8_t   burstId;
+   uint8_t   pktId;                         // first packet of the burst received
+   uint8_t   hops;                          // hops from the sensor to me
+   uint8_t   originAsn[4];                  // ASN of the light event, least significant byte first
+   uint8_t   rxAsn[4];                      // ASN I received the packet at, least significant byte first
+} light_trace_t;
+END_PACK
+
+BEGIN_PACK
+typedef struct {                            // latest burst of an origin, as advertised in EBs
+   uint16_t  origin;                        // LIGHT_ORIGIN_NONE if the entry is unused
+   uint8_t   light_info;
+} light_digest_t;
+END_PACK
+
+#define LIGHT_DIGEST_LENGTH       (LIGHT_DIGEST_NUMENTRIES*sizeof(light_digest_t))
+
+/**
+\brief Flood state of one sensor.
+*/
+typedef struct {
+   uint16_t             origin;             // short ID of the sensor, LIGHT_ORIGIN_NONE if the entry is free
+   uint8_t              burstId;            // current burst ID (identifying the event)
+   uint8_t              pktIDMap;           // each flag is set when the corresponding pktId was sent
+   uint8_t              numMissedBursts;    // number of burst I have missed and for which I need to catch-up
+   bool                 light_state;        // state of the light of this sensor (TRUE==on, FALSE==off)
+   uint8_t              tracedBurstId;      // last burst I logged the first reception of
+   uint8_t              hops;               // hops from the sensor to me, for the current burst
+   uint8_t              originAsn[4];       // ASN of the light event of the current burst
+   uint16_t             lastUsed;           // light_vars.useCounter at the last burst, for replacement
+} light_origin_t;
+
+/**
+\brief Decoder of the events of one window, with LIGHT_NETCODING.
+
+The rows are kept in reduced row echelon form, row i holding the combination
+whose first non-zero coefficient is that of sensor i, 1; it is all zero if
+there is none yet. An event is decoded once its row has no other non-zero
+coefficient.
+*/
+typedef struct {
+   bool                 used;
+   uint16_t             generation;
+   uint8_t              rank;
+   uint8_t              hops;               // hops from the closest sensor of the generation to me
+   uint8_t              delivered;          // each flag is set when the event of that sensor was decoded
+   uint8_t              rows[LIGHT_NC_MAXSYMBOLS][LIGHT_NC_ROW_LENGTH];
+} light_nc_gen_t;
+
+/**
+\brief Latest light sample, handed from the sampling task to the slot interrupt.
+
+The task only writes the buffer which is not published, then publishes it by
+writing idx, a single byte. The slot interrupt can preempt the task but not the
+other way around, so it always reads a complete sample without locking.
+*/
+typedef struct {
+   uint16_t             reading[2];         // double buffer of samples
+   volatile uint8_t     idx;                // buffer holding the latest sample
+   volatile uint8_t     seq;                // incremented after each sample is published
+} light_sample_t;
+
 //=========================== variables ========================================
 
 typedef struct {
    // app state
-   uint16_t             burstId;            // current burst ID (identifying the event)
-   uint8_t              pktIDMap;           // each flag is set when the corresponding pktId was sent
+   light_origin_t       origins[LIGHT_MAX_ORIGINS]; // flood state of each sensor, mine included
+   uint16_t             useCounter;         // incremented at each burst
+   uint8_t              digestIdx;          // next entry of origins to advertise in an EB
    uint16_t             light_reading;      // current light sensor reading
-   bool                 light_state;        // current state of the light (TRUE==on, FALSE==off)
    asn_t                lastEventAsn;       // holds the ASN of last event
-   uint16_t             numMissedBursts;    // number of burst I have missed and for which I need to catch-up
+#ifdef LIGHT_NETCODING
+   // network coding
+   light_nc_gen_t       generations[LIGHT_NC_NUMGENERATIONS];
+#endif
    // timers
    opentimer_id_t       fwdTimerId;         // timer ID for forwarding one packet
+   opentimer_id_t       sampleTimerId;      // timer ID for reading the light sensor
+   // sampling
+   light_sample_t       sample;             // latest sample, written by light_sample_task()
+   uint8_t              sampleSeqRead;      // seq of the last sample light_trigger_SENSOR() read
    // sending
    uint8_t              numBurstPktsSent;   // controls the number of packets transmitted in each event
 } light_vars_t;
@@ -68,7 +182,7 @@ typedef struct {
 // initialization
 void     light_init(void);
 void     light_trigger(slotOffset_t slotOffset);
-uint8_t  light_get_light_info(uint8_t pktId);
+void     light_getDigest(uint8_t* digest);
 void     light_sendDone(OpenQueueEntry_t* msg, owerror_t error);
 void     light_receive_data(OpenQueueEntry_t* msg);
 void     light_receive_beacon(OpenQueueEntry_t* msg);
@@ -18,7 +18,23 @@
 #include "processIE.h"
 #include "light.h"
 #include "sensors.h"
+#include "opentimers.h"
 #include "topology.h"
+#include "IEEE802154_security.h"
+#include "flashlog.h"
+#include "energy.h"
+
+//=========================== define ==========================================
+
+#ifdef BOARD_NVM
+// the erase starts once the slot ISR has run, at most maxTxDataPrepare into the slot
+#if FLASHWINDOW_SLOTS*PORT_TsSlotDuration<NVM_ERASE_TICKS+FLASHLOG_WINDOW_GUARD_TICKS+PORT_maxTxDataPrepare
+#error "FLASHWINDOW_SLOTS slots are too short to erase a flash page on this board, see NVM_ERASE_TICKS"
+#endif
+#if FLASHWINDOW_SLOTS>=SLOTFRAME_LENGTH
+#error "FLASHWINDOW_SLOTS must leave the EB cell of the slotframe"
+#endif
+#endif
 
 //=========================== variables =======================================
 
@@ -64,7 +80,7 @@ void     timeslotTemplateIDStoreFromEB(uint8_t id);
 // channelhopping template handling
 void     channelhoppingTemplateIDStoreFromEB(uint8_t id);
 // synchronization
-void     synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived);
+void     synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived, uint16_t timesource);
 void     changeIsSync(bool newIsSync);
 // notifying upper layer
 void     notif_sendDone(OpenQueueEntry_t* packetSent, owerror_t error);
@@ -72,6 +88,19 @@ void     notif_receive(OpenQueueEntry_t* packetReceived);
 // statistics
 void     resetStats(void);
 void     updateStats(PORT_SIGNED_INT_WIDTH timeCorrection);
+// guard time
+void     recordDriftRate(PORT_SIGNED_INT_WIDTH timeCorrection);
+uint8_t  rxGuardTime(void);
+// serial
+uint16_t serialBudgetTicks(void);
+uint16_t serialWindowTicks(void);
+// flash log
+void     flashWindowSlot(void);
+void     flashWindowCatchUp(void);
+void     skipSlot(void);
+// join
+uint8_t  joinChannel(void);
+uint8_t  joinChannelIndex(uint8_t freq);
 // misc
 uint8_t  calculateFrequency(uint8_t channelOffset);
 void     changeState(ieee154e_state_t newstate);
@@ -178,6 +207,10 @@ PORT_RADIOTIMER_WIDTH ieee154e_asnDiff(asn_t* someASN) {
 This function executes in ISR mode, when the new slot timer fires.
 */
 void isr_ieee154e_newSlot() {
+   // the timer wrapped, move the energy meter on before it reads the time
+   energy_newSlot(radio_getTimerPeriod());
+   energy_wakeup();
+   flashWindowCatchUp();
    if (ieee154e_vars.isSync==FALSE) {
       radio_setTimerPeriod(ieee154e_vars.syncSlotLength);
       ieee154e_vars.syncSlotLength = TsSlotDuration;
@@ -193,9 +226,16 @@ void isr_ieee154e_newSlot() {
       }
    } else {
       radio_setTimerPeriod(TsSlotDuration);
+#ifndef NOADAPTIVESYNC
+      // stretch or shrink this slot by a tick when my clock drift requires it
+      adaptive_sync_countCompensationTimeout();
+#endif
       activity_ti1ORri1();
    }
+   // the CPU is awake anyway, fire the timers which are due
+   opentimers_fireDueTimers();
    ieee154e_dbg.num_newSlot++;
+   energy_sleep();
 }
 
 /**
@@ -204,6 +244,7 @@ void isr_ieee154e_newSlot() {
 This function executes in ISR mode, when the FSM timer fires.
 */
 void isr_ieee154e_timer() {
+   energy_wakeup();
    switch (ieee154e_vars.state) {
       case S_TXDATAOFFSET:
          activity_ti2();
@@ -245,6 +286,7 @@ void isr_ieee154e_timer() {
          break;
    }
    ieee154e_dbg.num_timer++;
+   energy_sleep();
 }
 
 /**
@@ -253,6 +295,7 @@ void isr_ieee154e_timer() {
 This function executes in ISR mode.
 */
 void ieee154e_startOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
+   energy_wakeup();
    if (ieee154e_vars.isSync==FALSE) {
      activity_synchronize_startOfFrame(capturedTime);
    } else {
@@ -279,6 +322,7 @@ void ieee154e_startOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
       }
    }
    ieee154e_dbg.num_startOfFrame++;
+   energy_sleep();
 }
 
 /**
@@ -287,6 +331,7 @@ void ieee154e_startOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
 This function executes in ISR mode.
 */
 void ieee154e_endOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
+   energy_wakeup();
    if (ieee154e_vars.isSync==FALSE) {
       activity_synchronize_endOfFrame(capturedTime);
    } else {
@@ -308,6 +353,7 @@ void ieee154e_endOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
       }
    }
    ieee154e_dbg.num_endOfFrame++;
+   energy_sleep();
 }
 
 //======= misc
@@ -363,85 +409,64 @@ bool debugPrint_macStats() {
 //======= SYNCHRONIZING
 
 port_INLINE void activity_synchronize_newSlot() {
-   uint8_t i;
-   ieee154e_vars.joinChannelChangingCounter = (ieee154e_vars.joinChannelChangingCounter + 1)%EB_SLOWHOPPING_PERIOD;
-  
+   uint8_t freq;
+   
+   // increment ASN (used to predict the EB channel and schedule serial activity)
+   incrementAsnOffset();
+   if (ieee154e_vars.joinPredictSlots>0) {
+      ieee154e_vars.joinPredictSlots--;
+   }
+   
+   // charge this slot to listening for EBs
+   energy_setBudget(ENERGY_BUDGET_SYNC);
+   
    // I'm in the middle of receiving a packet
    if (ieee154e_vars.state==S_SYNCRX) {
       return;
    }
    
+   // the flash log has work, which stalls the CPU: stop listening meanwhile, an
+   // EB would be timestamped late; not while my ASN still predicts the EB
+   // channel, those slots are worth listening
+   if (
+         (ieee154e_vars.asn.bytes0and1&0x000f)==0x0004 &&
+         ieee154e_vars.joinPredictSlots==0              &&
+         (flashlog_needsErase()==TRUE || flashlog_hasRecords()==TRUE)
+      ) {
+      // the next slot switches the radio back on in Rx mode
+      flashWindowSlot();
+      return;
+   }
+   
+   // pick the channel to listen on during this slot
+   freq = joinChannel();
+   
    // if this is the first time I call this function while not synchronized,
-   // switch on the radio in Rx mode
-   if (ieee154e_vars.state!=S_SYNCLISTEN) {
+   // or the channel changed, switch on the radio in Rx mode on that channel
+   if (ieee154e_vars.state!=S_SYNCLISTEN || freq!=ieee154e_vars.freq) {
       // change state
       changeState(S_SYNCLISTEN);
       
       // turn off the radio (in case it wasn't yet)
       radio_rfOff();
       
-      // configure the radio to listen to the default synchronizing channel
-      radio_setFrequency(SYNCHRONIZING_CHANNEL);
-      
       // update record of current channel
-      ieee154e_vars.freq = SYNCHRONIZING_CHANNEL;
+      ieee154e_vars.freq = freq;
       
-      // switch on the radio in Rx mode.
-      radio_rxEnable();
-      ieee154e_vars.radioOnInit=radio_getTimerValue();
-      ieee154e_vars.radioOnThisSlot=TRUE;
-      radio_rxNow();
-   }
-   
-   if (ieee154e_vars.state==S_SYNCLISTEN && ieee154e_vars.joinChannelChangingCounter == 0){
-      // turn off the radio (in case it wasn't yet)
-      radio_rfOff();
-      
-      i=0;
-      while (ieee154e_vars.freq-11 != ieee154e_vars.chTemplateEB[i] && i<EB_NUMCHANS){
-          i++;
-      }
-      
-      if (i<EB_NUMCHANS){
-          ieee154e_vars.freq = 11 + ieee154e_vars.chTemplateEB[(i+1)%EB_NUMCHANS];
-      }
-      
-      // configure the radio to listen to the default synchronizing channel
+      // configure the radio to listen to this channel
       radio_setFrequency(ieee154e_vars.freq);
       
       // switch on the radio in Rx mode.
       radio_rxEnable();
       ieee154e_vars.radioOnInit=radio_getTimerValue();
       ieee154e_vars.radioOnThisSlot=TRUE;
+      energy_radioOn(ENERGY_LOAD_RX,0);
       radio_rxNow();
    }
    
-   // if I'm already in S_SYNCLISTEN, while not synchronized,
-   // but the synchronizing channel has been changed,
-   // change the synchronizing channel
-   if ((ieee154e_vars.state==S_SYNCLISTEN) && (ieee154e_vars.singleChannelChanged == TRUE)) {
-      // turn off the radio (in case it wasn't yet)
-      radio_rfOff();
-      
-      // update record of current channel
-      ieee154e_vars.freq = calculateFrequency(ieee154e_vars.singleChannel);
-      
-      // configure the radio to listen to the default synchronizing channel
-      radio_setFrequency(ieee154e_vars.freq);
-      
-      // switch on the radio in Rx mode.
-      radio_rxEnable();
-      ieee154e_vars.radioOnInit=radio_getTimerValue();
-      ieee154e_vars.radioOnThisSlot=TRUE;
-      radio_rxNow();
-      ieee154e_vars.singleChannelChanged = FALSE;
-   }
-   
-   // increment ASN (used only to schedule serial activity)
-   incrementAsnOffset();
-   
    // to be able to receive and transmist serial even when not synchronized
    // take turns every 8 slots sending and receiving
+   energy_setBudget(ENERGY_BUDGET_SERIAL);
    if        ((ieee154e_vars.asn.bytes0and1&0x000f)==0x0000) {
       openserial_stop();
       openserial_startOutput();
@@ -449,9 +474,11 @@ port_INLINE void activity_synchronize_newSlot() {
       openserial_stop();
       openserial_startInput();
    }
+   energy_setBudget(ENERGY_BUDGET_SYNC);
 }
 
 port_INLINE void activity_synchronize_startOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
+   uint8_t i;
    
    // don't care about packet if I'm not listening
    if (ieee154e_vars.state!=S_SYNCLISTEN) {
@@ -464,6 +491,12 @@ port_INLINE void activity_synchronize_startOfFrame(PORT_RADIOTIMER_WIDTH capture
    // stop the serial
    openserial_stop();
    
+   // this channel is busy, scan it first next time
+   i = joinChannelIndex(ieee154e_vars.freq);
+   if (i<EB_NUMCHANS && ieee154e_vars.joinEnergy[i]<0xff) {
+      ieee154e_vars.joinEnergy[i]++;
+   }
+   
    // record the captured time 
    ieee154e_vars.lastCapturedTime = capturedTime;
    
@@ -472,8 +505,10 @@ port_INLINE void activity_synchronize_startOfFrame(PORT_RADIOTIMER_WIDTH capture
 }
 
 port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedTime) {
-   uint8_t    i;
    eb_ht*     eb;
+#ifdef L2_SECURITY_ACTIVE
+   asn_t      ebAsn;
+#endif
    
    // check state
    if (ieee154e_vars.state!=S_SYNCRX) {
@@ -526,7 +561,7 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
                                    &ieee154e_vars.dataReceived->l1_crc);
       
       // break if wrong length
-      if (ieee154e_vars.dataReceived->length!=sizeof(eb_ht)+2) {
+      if (ieee154e_vars.dataReceived->length!=sizeof(eb_ht)+LENGTH_MIC+LENGTH_CRC) {
          break;
       }
       
@@ -535,16 +570,14 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
          break;
       }
       
+      // toss CRC (2 last bytes)
+      packetfunctions_tossFooter(ieee154e_vars.dataReceived, LENGTH_CRC);
+      
       // break if not beacon
       if (((eb_ht*)(ieee154e_vars.dataReceived->payload))->type != LONGTYPE_BEACON) {
          break;
       }
       
-      // break if not new syncnum
-      if (((eb_ht*)(ieee154e_vars.dataReceived->payload))->syncnum==ieee154e_vars.syncnum) {
-         break;
-      }
-      
       // break if from node outside of allowed topology
       if (topology_isAcceptablePacket(((eb_ht*)(ieee154e_vars.dataReceived->payload))->src)==FALSE) {
          break;
@@ -556,13 +589,27 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
             TsSlotDuration-ieee154e_vars.syncCapturedTime<RESYNCHRONIZATIONGUARD
       ) {
          ieee154e_vars.syncSlotLength = (TsSlotDuration*25)/10;
+         // stretching the slot shifts my ASN away from the network's
+         ieee154e_vars.joinPredictSlots = 0;
+         break;
+      }
+      
+#ifdef L2_SECURITY_ACTIVE
+      // break if the EB is not authentic, I don't know the ASN yet, take the one it advertises
+      eb = (eb_ht*)(ieee154e_vars.dataReceived->payload);
+      ebAsn.bytes0and1 = eb->asn0+256*eb->asn1;
+      ebAsn.bytes2and3 = eb->asn2+256*eb->asn3;
+      ebAsn.byte4      = 0;
+      if (IEEE802154_security_incomingFrame(ieee154e_vars.dataReceived,&ebAsn)!=E_SUCCESS) {
          break;
       }
+#endif
       
       //=== if I get here, I got a valid beacon at the right time, I can stop listening
       
       // turn off the radio
       radio_rfOff();
+      energy_radioOff();
       
       // parse eb
       eb = (eb_ht*)(ieee154e_vars.dataReceived->payload);
@@ -583,23 +630,15 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
       ieee154e_vars.nextActiveSlotOffset = schedule_getNextActiveSlotOffset();
       
       // infer the asnOffset based on the fact that
-      // ieee154e_vars.freq = 11 + (asnOffset + channelOffset)%16 
-      for (i=0;i<EB_NUMCHANS;i++){
-         if ((ieee154e_vars.freq - 11)==ieee154e_vars.chTemplateEB[i]){
-            break;
-         }
-      }
-      ieee154e_vars.ebAsnOffset = i - schedule_getChannelOffset();      
+      // ieee154e_vars.freq = 11 + chTemplateEB[(asnOffset + channelOffset)%EB_NUMCHANS]
+      ieee154e_vars.ebAsnOffset = joinChannelIndex(ieee154e_vars.freq) - schedule_getChannelOffset();
       ieee154e_vars.dataAsnOffset = ieee154e_vars.asn.bytes0and1%16 - schedule_getChannelOffset();
       
       // compute radio duty cycle
       ieee154e_vars.radioOnTics += (radio_getTimerValue()-ieee154e_vars.radioOnInit);
       
-      // toss CRC (2 last bytes)
-      packetfunctions_tossFooter(ieee154e_vars.dataReceived, LENGTH_CRC);
-      
       // synchronize to the slot boundary
-      synchronizePacket(ieee154e_vars.syncCapturedTime); // first synchronization
+      synchronizePacket(ieee154e_vars.syncCapturedTime,eb->src); // first synchronization
       
       // declare synchronized
       changeIsSync(TRUE);
@@ -649,6 +688,8 @@ port_INLINE void activity_ti1ORri1() {
    debugpins_slot_toggle();
    if (ieee154e_vars.slotOffset==0) {
       debugpins_frame_toggle();
+      // hand the serial its budget for this slotframe
+      openserial_newSlotframe(serialBudgetTicks());
    }
    
    // desynchronize if needed
@@ -666,12 +707,32 @@ port_INLINE void activity_ti1ORri1() {
          // update the statistics
          ieee154e_stats.numDeSync++;
          
+         // my ASN still matches the network's for a while, use it to rejoin
+         ieee154e_vars.joinPredictSlots = JOIN_PREDICTION_SLOTS;
+         ieee154e_vars.joinDwellCounter = 0;
+         
          // abort
          endSlot();
          return;
       }
    }
    
+   // no idle time in the schedule is long enough to erase a flash page, give
+   // the flash log the last slots of the slotframe, which keeps the EB cell
+   if (
+         ieee154e_vars.slotOffset==SLOTFRAME_LENGTH-FLASHWINDOW_SLOTS &&
+         ieee154e_vars.state==S_SLEEP                                 &&
+         (
+            idmanager_getIsDAGroot()==TRUE ||
+            ieee154e_vars.deSyncTimeout>FLASHWINDOW_SLOTS
+         )                                                            &&
+         flashlog_needsErase()==TRUE
+      ) {
+      skipSlot();
+      flashWindowSlot();
+      return;
+   }
+   
    if (ieee154e_vars.slotOffset==ieee154e_vars.nextActiveSlotOffset) {
       // this is the next active slot
       
@@ -684,10 +745,8 @@ port_INLINE void activity_ti1ORri1() {
       // this is NOT the next active slot, abort
       // stop using serial
       openserial_stop();
-      // abort the slot
+      // abort the slot, this opens a serial window until the next active slot
       endSlot();
-      //start outputing serial
-      openserial_startOutput();
       return;
    }
    
@@ -704,17 +763,23 @@ port_INLINE void activity_ti1ORri1() {
       return;
    }
    
+   // check the schedule to see what type of slot this is
+   cellType = schedule_getType();
+   
+   // charge this slot to the EBs or to the flood
+   if (cellType==CELLTYPE_EB) {
+      energy_setBudget(ENERGY_BUDGET_EB);
+   } else {
+      energy_setBudget(ENERGY_BUDGET_FLOOD);
+   }
+   
    // trigger application, which can send packet
    light_trigger(ieee154e_vars.slotOffset);
    
-   // check the schedule to see what type of slot this is
-   cellType = schedule_getType();
    switch (cellType) {
       case CELLTYPE_EB:
-         // have 6top create an EB packet every AVERAGEDEGREE EB slots, on average
-         if (openrandom_get16b()%AVERAGEDEGREE==0) {
-            sixtop_sendEB();
-         }
+         // have 6top create an EB packet, when its Trickle timer fires
+         sixtop_sendEB();
       case CELLTYPE_TXRX:
          // stop using serial
          openserial_stop();
@@ -734,6 +799,9 @@ port_INLINE void activity_ti1ORri1() {
          if (ieee154e_vars.dataToSend==NULL) {
             // listen
             
+            // only listen as long as my synchronization error requires
+            ieee154e_vars.rxGuardTime = rxGuardTime();
+            
             // change state
             changeState(S_RXDATAOFFSET);
             // arm rt1
@@ -795,6 +863,14 @@ port_INLINE void activity_ti2() {
    // make a local copy of the frame
    packetfunctions_duplicatePacket(&ieee154e_vars.localCopyForTransmission, ieee154e_vars.dataToSend);
    
+#ifdef L2_SECURITY_ACTIVE
+   // authenticate the local copy, its MIC depends on the ASN of this slot
+   if (IEEE802154_security_outgoingFrame(&ieee154e_vars.localCopyForTransmission,&ieee154e_vars.asn)!=E_SUCCESS) {
+      endSlot();
+      return;
+   }
+#endif
+   
    // add 2 CRC bytes only to the local copy as we end up here for each retransmission
    packetfunctions_reserveFooterSize(&ieee154e_vars.localCopyForTransmission, 2);
    
@@ -804,6 +880,9 @@ port_INLINE void activity_ti2() {
    // configure the radio for that frequency
    radio_setFrequency(ieee154e_vars.freq);
    
+   // and for the power picked for this frame
+   radio_setTxPower(ieee154e_vars.dataToSend->l1_txPower);
+   
    // load the packet in the radio's Tx buffer
    radio_loadPacket(ieee154e_vars.localCopyForTransmission.payload,
                     ieee154e_vars.localCopyForTransmission.length);
@@ -813,6 +892,7 @@ port_INLINE void activity_ti2() {
    
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
+   energy_radioOn(ENERGY_LOAD_TX,ieee154e_vars.dataToSend->l1_txPower);
    // arm tt2
    radiotimer_schedule(DURATION_tt2);
    
@@ -886,6 +966,7 @@ port_INLINE void activity_ti5(PORT_RADIOTIMER_WIDTH capturedTime) {
    
    // turn off the radio
    radio_rfOff();
+   energy_radioOff();
    
    ieee154e_vars.radioOnTics+=(radio_getTimerValue()-ieee154e_vars.radioOnInit);
    
@@ -921,6 +1002,7 @@ port_INLINE void activity_ri2() {
    
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
+   energy_radioOn(ENERGY_LOAD_RX,0);
    
    // arm rt2
    radiotimer_schedule(DURATION_rt2);
@@ -994,6 +1076,7 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
    
    // turn off the radio
    radio_rfOff();
+   energy_radioOff();
    
    // adjust power calculation
    ieee154e_vars.radioOnTics+=radio_getTimerValue()-ieee154e_vars.radioOnInit;
@@ -1066,6 +1149,13 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
          break;
       }
       
+#ifdef L2_SECURITY_ACTIVE
+      // break if the frame is not authentic
+      if (IEEE802154_security_incomingFrame(ieee154e_vars.dataReceived,&ieee154e_vars.asn)!=E_SUCCESS) {
+         break;
+      }
+#endif
+      
       // record the captured time
       ieee154e_vars.lastCapturedTime = capturedTime;
       
@@ -1075,8 +1165,10 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
          neighbors_isPreferredParent(eb->src) &&
          eb->syncnum!=ieee154e_vars.syncnum
       ) {
-         synchronizePacket(ieee154e_vars.syncCapturedTime);
+         synchronizePacket(ieee154e_vars.syncCapturedTime,eb->src);
          ieee154e_vars.syncnum = eb->syncnum;
+         // my EBs now advertise a new syncnum, send them faster
+         sixtop_resetEBTrickle();
       }
       
       // indicate reception to upper layer
@@ -1215,7 +1307,6 @@ void ieee154e_setSingleChannel(uint8_t channel){
         return;
     }
     ieee154e_vars.singleChannel = channel;
-    ieee154e_vars.singleChannelChanged = TRUE;
 }
 
 // timeslot template handling
@@ -1229,7 +1320,7 @@ port_INLINE void channelhoppingTemplateIDStoreFromEB(uint8_t id){
 }
 //======= synchronization
 
-void synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived) {
+void synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived, uint16_t timesource) {
    PORT_SIGNED_INT_WIDTH timeCorrection;
    PORT_RADIOTIMER_WIDTH newPeriod;
    
@@ -1241,6 +1332,16 @@ void synchronizePacket(PORT_RADIOTIMER_WIDTH timeReceived) {
    // resynchronize by applying the new period
    radio_setTimerPeriod(newPeriod);
    
+#ifndef NOADAPTIVESYNC
+   // refine the estimate of my clock drift relative to this time source
+   adaptive_sync_indicateTimeCorrection((int16_t)timeCorrection,timesource);
+#endif
+   
+   // learn how fast I drift away from the network, before the timeout is reset
+   if (ieee154e_vars.isSync==TRUE) {
+      recordDriftRate(timeCorrection);
+   }
+   
    // reset the de-synchronization timeout
    ieee154e_vars.deSyncTimeout    = DESYNCTIMEOUT;
    
@@ -1270,6 +1371,9 @@ void changeIsSync(bool newIsSync) {
       resetStats();
    } else {
       leds_sync_on();
+      // the drift observed before losing sync says nothing of the next resync
+      ieee154e_vars.numDriftRates  = 0;
+      ieee154e_vars.driftRatesIdx  = 0;
    }
 }
 
@@ -1280,11 +1384,14 @@ void notif_sendDone(OpenQueueEntry_t* packetSent, owerror_t error) {
    packetSent->l2_sendDoneError   = error;
    // record the current ASN
    memcpy(&packetSent->l2_asn,&ieee154e_vars.asn,sizeof(asn_t));
+   // a pending sendDone task drains every sent packet, only post one if none
+   // is already waiting
+   if (openqueue_sixtopGetSentPacket()==NULL) {
+      scheduler_push_task(task_sixtopNotifSendDone,TASKPRIO_SIXTOP_NOTIF_TXDONE);
+   }
    // associate this packet with the virtual component
    // COMPONENT_IEEE802154E_TO_RES so RES can knows it's for it
    packetSent->owner              = COMPONENT_IEEE802154E_TO_SIXTOP;
-   // post RES's sendDone task
-   scheduler_push_task(task_sixtopNotifSendDone,TASKPRIO_SIXTOP_NOTIF_TXDONE);
    // wake up the scheduler
    SCHEDULER_WAKEUP();
 }
@@ -1296,11 +1403,14 @@ void notif_receive(OpenQueueEntry_t* packetReceived) {
    // indicate reception to the schedule, to keep statistics
    schedule_indicateRx(&packetReceived->l2_asn);
    
+   // a pending receive task drains every received packet, only post one if
+   // none is already waiting
+   if (openqueue_sixtopGetReceivedPacket()==NULL) {
+      scheduler_push_task(task_sixtopNotifReceive,TASKPRIO_SIXTOP_NOTIF_RX);
+   }
    // associate this packet with the virtual component
    // COMPONENT_IEEE802154E_TO_SIXTOP so sixtop can knows it's for it
    packetReceived->owner          = COMPONENT_IEEE802154E_TO_SIXTOP;
-   // post 6top's Receive task
-   scheduler_push_task(task_sixtopNotifReceive,TASKPRIO_SIXTOP_NOTIF_RX);
    // wake up the scheduler
    SCHEDULER_WAKEUP();
 }
@@ -1328,6 +1438,188 @@ void updateStats(PORT_SIGNED_INT_WIDTH timeCorrection) {
    }
 }
 
+//======= guard time
+
+/**
+\brief Record the drift observed at a resynchronization.
+
+The drift rate is the time correction divided by the number of slots elapsed
+since the previous resynchronization, in ticks per 1024 slots. The last
+RXGUARDTIME_WINDOW rates are kept.
+
+\param[in] timeCorrection The time correction being applied.
+*/
+void recordDriftRate(PORT_SIGNED_INT_WIDTH timeCorrection) {
+   uint16_t elapsedSlots;
+   uint32_t rate;
+   
+   elapsedSlots = DESYNCTIMEOUT-ieee154e_vars.deSyncTimeout;
+   if (elapsedSlots==0) {
+      return;
+   }
+   
+   if (timeCorrection<0) {
+      timeCorrection = -timeCorrection;
+   }
+   rate = ((uint32_t)timeCorrection<<10)/elapsedSlots;
+   if (rate>0xffff) {
+      rate = 0xffff;
+   }
+   
+   ieee154e_vars.driftRates[ieee154e_vars.driftRatesIdx] = (uint16_t)rate;
+   ieee154e_vars.driftRatesIdx = (ieee154e_vars.driftRatesIdx+1)%RXGUARDTIME_WINDOW;
+   if (ieee154e_vars.numDriftRates<RXGUARDTIME_WINDOW) {
+      ieee154e_vars.numDriftRates++;
+   }
+}
+
+/**
+\brief Guard time of an RX slot starting now, in ticks.
+
+The worst drift rate of the window, applied to the slots elapsed since my last
+resynchronization, bounds my error. The sender drifted as well since its own
+resynchronization, assumed at the same rate, hence the factor 2. The DAGroot,
+or a mote which has not resynchronized RXGUARDTIME_WINDOW times yet, has no
+estimate and uses TsLongGT.
+
+The sender may be any neighbor, e.g. in a TXRX cell, synchronized through
+another parent or which missed the last syncnum: its offset does not depend on
+my last resynchronization. The guard time therefore never drops below twice
+the largest time correction I applied since I synchronized, which bounds the
+offset of a mote to the network at its resynchronization.
+*/
+port_INLINE uint8_t rxGuardTime() {
+   uint8_t  i;
+   uint16_t maxRate;
+   uint32_t drift;
+   int16_t  worstCorrection;
+   
+   if (
+         idmanager_getIsDAGroot()==TRUE ||
+         ieee154e_vars.numDriftRates<RXGUARDTIME_WINDOW
+      ) {
+      return TsLongGT;
+   }
+   
+   maxRate = 0;
+   for (i=0;i<RXGUARDTIME_WINDOW;i++) {
+      if (ieee154e_vars.driftRates[i]>maxRate) {
+         maxRate = ieee154e_vars.driftRates[i];
+      }
+   }
+   
+   // round up, a tick of drift is a tick missing from the listen window
+   drift  = (uint32_t)maxRate*(DESYNCTIMEOUT-ieee154e_vars.deSyncTimeout);
+   drift  = 2*((drift+1023)>>10);
+   
+   // no less than the offsets seen between motes, wherever they synced from
+   worstCorrection = ieee154e_stats.maxCorrection;
+   if (-ieee154e_stats.minCorrection>worstCorrection) {
+      worstCorrection = -ieee154e_stats.minCorrection;
+   }
+   if (worstCorrection>0 && drift<2*(uint32_t)worstCorrection) {
+      drift  = 2*(uint32_t)worstCorrection;
+   }
+   
+   if (drift>TsLongGT-RXGUARDTIME_MIN) {
+      return TsLongGT;
+   }
+   return RXGUARDTIME_MIN+(uint8_t)drift;
+}
+
+//======= serial
+
+/**
+\brief Number of ticks per slotframe the radio leaves to the serial.
+
+Inactive slots are entirely free. An active slot without traffic is free after
+the receiver gives up listening, at most at TsTxOffset+TsLongGT; slots with traffic end
+later, so this is an upper bound which openserial enforces per window as well.
+*/
+port_INLINE uint16_t serialBudgetTicks() {
+   uint8_t numActive;
+   
+   numActive = schedule_getNumActiveSlots();
+   
+   return (SLOTFRAME_LENGTH-numActive)*TsSlotDuration+
+          numActive*(TsSlotDuration-TsTxOffset-TsLongGT);
+}
+
+/**
+\brief Number of ticks from now until the next active slot starts.
+*/
+port_INLINE uint16_t serialWindowTicks() {
+   PORT_RADIOTIMER_WIDTH now;
+   PORT_RADIOTIMER_WIDTH period;
+   uint16_t              numIdleSlots;
+   uint16_t              ticks;
+   
+   now          = radio_getTimerValue();
+   period       = radio_getTimerPeriod();
+   numIdleSlots = (ieee154e_vars.nextActiveSlotOffset+SLOTFRAME_LENGTH-ieee154e_vars.slotOffset-1)%SLOTFRAME_LENGTH;
+   
+   ticks        = numIdleSlots*TsSlotDuration;
+   if (now<period) {
+      ticks    += period-now;
+   }
+   return ticks;
+}
+
+//======= flash log
+
+/**
+\brief Stretch this slot to FLASHWINDOW_SLOTS slots, radio off, and hand it to
+   the flash log.
+
+Erasing a flash page stalls the CPU longer than any idle time the schedule
+leaves. No slot boundary, frame or timestamp falls within this window; the
+next slot catches the ASN up, see flashWindowCatchUp().
+*/
+port_INLINE void flashWindowSlot() {
+   
+   // stop listening
+   radio_rfOff();
+   energy_radioOff();
+   changeState(S_SLEEP);
+   
+   // the slot timer fires once the window is over, keep the adaptive sync tick
+   radio_setTimerPeriod(radio_getTimerPeriod()+(FLASHWINDOW_SLOTS-1)*TsSlotDuration);
+   ieee154e_vars.flashWindowSlotsLeft = FLASHWINDOW_SLOTS-1;
+   
+   energy_setBudget(ENERGY_BUDGET_SERIAL);
+   openserial_stop();
+   flashlog_startWindow(radio_getTimerPeriod()-radio_getTimerValue());
+   energy_setBudget(ENERGY_BUDGET_IDLE);
+}
+
+/**
+\brief Account for the slots the last one stood for, see flashWindowSlot().
+*/
+port_INLINE void flashWindowCatchUp() {
+   while (ieee154e_vars.flashWindowSlotsLeft>0) {
+      ieee154e_vars.flashWindowSlotsLeft--;
+      incrementAsnOffset();
+      if (ieee154e_vars.isSync==TRUE) {
+         skipSlot();
+         if (idmanager_getIsDAGroot()==FALSE) {
+            ieee154e_vars.deSyncTimeout--;
+         }
+      } else if (ieee154e_vars.joinPredictSlots>0) {
+         ieee154e_vars.joinPredictSlots--;
+      }
+   }
+}
+
+/**
+\brief Move the schedule past this slot, without its activity.
+*/
+port_INLINE void skipSlot() {
+   if (ieee154e_vars.slotOffset==ieee154e_vars.nextActiveSlotOffset) {
+      schedule_advanceSlot();
+      ieee154e_vars.nextActiveSlotOffset = schedule_getNextActiveSlotOffset();
+   }
+}
+
 //======= misc
 
 /**
@@ -1363,6 +1655,72 @@ port_INLINE uint8_t calculateFrequency(uint8_t channelOffset) {
     }
 }
 
+/**
+\brief Frequency a joining mote listens on during this slot.
+
+Right after a desynchronization, my ASN still matches the network's, so I know
+which channel the EB cell of this slot uses and listen there. Otherwise, I scan
+the EB channels, JOIN_DWELL_SLOTS on each, going first to the channel on which
+I heard the most frames recently. Any valid EB, on any channel, is accepted.
+
+\returns The frequency, an integer between 11 and 26.
+*/
+port_INLINE uint8_t joinChannel() {
+   uint8_t i;
+   uint8_t current;
+   uint8_t next;
+   
+   if (ieee154e_vars.joinPredictSlots>0) {
+      // EB cells use channel offset 0
+      return 11+ieee154e_vars.chTemplateEB[ieee154e_vars.ebAsnOffset];
+   }
+   
+   // start on the default synchronizing channel
+   current = joinChannelIndex(ieee154e_vars.freq);
+   if (current==EB_NUMCHANS) {
+      ieee154e_vars.joinDwellCounter = JOIN_DWELL_SLOTS;
+      return SYNCHRONIZING_CHANNEL;
+   }
+   
+   // keep scanning this channel
+   if (ieee154e_vars.joinDwellCounter>0) {
+      ieee154e_vars.joinDwellCounter--;
+      return ieee154e_vars.freq;
+   }
+   
+   // move to the busiest other channel, the next one in sequence on a tie
+   next = (current+1)%EB_NUMCHANS;
+   for (i=2;i<EB_NUMCHANS;i++) {
+      if (ieee154e_vars.joinEnergy[(current+i)%EB_NUMCHANS]>ieee154e_vars.joinEnergy[next]) {
+         next = (current+i)%EB_NUMCHANS;
+      }
+   }
+   
+   // age the energy, so a channel which went quiet loses its priority
+   for (i=0;i<EB_NUMCHANS;i++) {
+      ieee154e_vars.joinEnergy[i] /= 2;
+   }
+   
+   ieee154e_vars.joinDwellCounter = JOIN_DWELL_SLOTS;
+   return 11+ieee154e_vars.chTemplateEB[next];
+}
+
+/**
+\brief Index of a frequency in the EB channel template.
+
+\returns The index, or EB_NUMCHANS if EBs are not sent on this frequency.
+*/
+port_INLINE uint8_t joinChannelIndex(uint8_t freq) {
+   uint8_t i;
+   
+   for (i=0;i<EB_NUMCHANS;i++) {
+      if (freq-11==ieee154e_vars.chTemplateEB[i]) {
+         break;
+      }
+   }
+   return i;
+}
+
 /**
 \brief Changes the state of the IEEE802.15.4e FSM.
 
@@ -1427,6 +1785,7 @@ void endSlot() {
   
    // turn off the radio
    radio_rfOff();
+   energy_radioOff();
    
    // compute the duty cycle if radio has been turned on
    if (ieee154e_vars.radioOnThisSlot==TRUE){  
@@ -1504,8 +1863,21 @@ void endSlot() {
    
    // change state
    changeState(S_SLEEP);
+   
+   // the radio is idle until the next active slot, let the serial use that time
+   if (ieee154e_vars.isSync==TRUE) {
+      energy_setBudget(ENERGY_BUDGET_SERIAL);
+      openserial_stop();
+      flashlog_startWindow(serialWindowTicks());
+      openserial_startWindow(serialWindowTicks());
+      energy_setBudget(ENERGY_BUDGET_IDLE);
+   }
 }
 
 bool ieee154e_isSynch(){
    return ieee154e_vars.isSync;
 }
+
+uint8_t ieee154e_getSyncnum(){
+   return ieee154e_vars.syncnum;
+}
@@ -24,7 +24,8 @@ static const uint8_t chTemplate_eb[] = {
    0,4,9,15                            // channels to send EBs on (-11, i.e. 0=channel 11) (0,4,9,15)==(11,15,20,26)
 };
 #define EB_NUMCHANS                 4  // number of channels EBs are sent on
-#define EB_SLOWHOPPING_PERIOD    1000  // how often a node changes the channel it listens on for EBs, in slots (1000=4610ms)
+#define JOIN_DWELL_SLOTS         (2*EB_NUMCHANS*SLOTFRAME_LENGTH) // how long a joining node scans an EB channel, in slots (each EB cell visits it twice)
+#define JOIN_PREDICTION_SLOTS    2169  // how long after a desync the EB channel is predicted from my ASN, in slots (~10 s)
 //=========================== define ==========================================
 
 #ifdef SETUP_USBHUB
@@ -39,19 +40,18 @@ static const uint8_t chTemplate_eb[] = {
 
 #define SYNCHRONIZING_CHANNEL       26 // channel the mote listens on to synchronize
 #define TXRETRIES                    0 // number of MAC retries before declaring failed
-#define TX_POWER                    31 // 1=-25dBm, 31=0dBm (max value)
+#define TX_POWER                    31 // the radio's maximum, see radio_setTxPower()
 #define RESYNCHRONIZATIONGUARD      60 // in 32kHz ticks. min distance to the end of the slot to successfully synchronize
 #define US_PER_TICK                 30 // number of us per 32kHz clock tick
-#define EBPERIOD                  1000 // in ms, EB sending period
 #define MAXKAPERIOD                200 // in slots: @15ms per slot -> ~30 seconds. Max value used by adaptive synchronization.
 #define DESYNCTIMEOUT             2169 // in slots: 2169@4.61ms per slot -> ~10 seconds
 #define LIMITLARGETIMECORRECTION     5 // threshold number of ticks to declare a timeCorrection "large"
+#define RXGUARDTIME_MIN              3 // in 32kHz ticks, capture jitter any RX guard time covers
+#define RXGUARDTIME_WINDOW           8 // number of resynchronizations the RX guard time is estimated from
+#define FLASHWINDOW_SLOTS            4 // in slots, how long the radio stays off while the flash log erases a page
 #define LENGTH_IEEE154_MAX         128 // max length of a valid radio packet  
 #define DUTY_CYCLE_WINDOW_LIMIT    (0xFFFFFFFF>>1) // limit of the dutycycle window
 
-#define EB_PERIOD_TIMER   2000 // every 2 seconds increase the EB period by a certain amount
-#define EB_PERIOD_AMOUNT     2 // increase by 1 (multiples of 100 ms)
-#define EB_PERIOD_MAX       20 // max EB interval will be 10 (multiples of 100 ms)
 #define EB_JUMP_COUNTER      2 // every 4 seconds jump to another channel
 
 //15.4e information elements related
@@ -192,9 +192,9 @@ enum ieee154e_linkOption_enum {
 #define DURATION_tt3 ieee154e_vars.lastCapturedTime+TsTxOffset-delayTx+wdRadioTx
 #define DURATION_tt4 ieee154e_vars.lastCapturedTime+wdDataDuration
 // RX
-#define DURATION_rt1 ieee154e_vars.lastCapturedTime+TsTxOffset-TsLongGT-delayRx-maxRxDataPrepare
-#define DURATION_rt2 ieee154e_vars.lastCapturedTime+TsTxOffset-TsLongGT-delayRx
-#define DURATION_rt3 ieee154e_vars.lastCapturedTime+TsTxOffset+TsLongGT
+#define DURATION_rt1 ieee154e_vars.lastCapturedTime+TsTxOffset-ieee154e_vars.rxGuardTime-delayRx-maxRxDataPrepare
+#define DURATION_rt2 ieee154e_vars.lastCapturedTime+TsTxOffset-ieee154e_vars.rxGuardTime-delayRx
+#define DURATION_rt3 ieee154e_vars.lastCapturedTime+TsTxOffset+ieee154e_vars.rxGuardTime
 #define DURATION_rt4 ieee154e_vars.lastCapturedTime+wdDataDuration
 
 //=========================== typedef =========================================
@@ -233,7 +233,6 @@ typedef struct {
    uint8_t                   ebAsnOffset;               // offset inside the frame for eb
    uint8_t                   dataAsnOffset;           // offset inside the frame for data
    uint8_t                   singleChannel;           // the single channel used for transmission
-   bool                      singleChannelChanged;    // detect id singleChannelChanged
    uint8_t                   chTemplate[16];          // storing the template of hopping sequence
    uint8_t                   chTemplateEB[EB_NUMCHANS];    // hopping sequence for EB
    // template ID
@@ -250,6 +249,11 @@ typedef struct {
    // time correction
    int16_t                   timeCorrection;          // store the timeCorrection, prepend and retrieve it inside of frame header
    uint16_t                  syncSlotLength;
+   // guard time
+   uint8_t                   rxGuardTime;             // guard time of the current RX slot, at most TsLongGT
+   uint16_t                  driftRates[RXGUARDTIME_WINDOW]; // |timeCorrection| per 1024 slots, at the last resynchronizations
+   uint8_t                   driftRatesIdx;           // entry of driftRates written next
+   uint8_t                   numDriftRates;           // number of valid entries in driftRates
    // flooding counter
    uint16_t                  floodingCounter;
    // flooding state
@@ -258,7 +262,12 @@ typedef struct {
    uint8_t                   nextChannelEB;
    uint8_t                   jumpCounter;
    
-   uint16_t                  joinChannelChangingCounter;
+   // join
+   uint16_t                  joinDwellCounter;        // slots left on the EB channel being scanned
+   uint16_t                  joinPredictSlots;        // slots left during which my ASN still predicts the EB channel
+   uint8_t                   joinEnergy[EB_NUMCHANS]; // frames heard on each EB channel while scanning, decaying
+   // flash log
+   uint8_t                   flashWindowSlotsLeft;    // slots the last one stood for, besides itself, see flashWindowSlot()
 } ieee154e_vars_t;
 
 BEGIN_PACK
@@ -287,6 +296,7 @@ void               ieee154e_init(void);
 // public
 PORT_RADIOTIMER_WIDTH   ieee154e_asnDiff(asn_t* someASN);
 bool               ieee154e_isSynch(void);
+uint8_t            ieee154e_getSyncnum(void);
 void               ieee154e_getAsn(uint8_t* array);
 void               ieee154e_getAsnStruct(asn_t* toAsn);
 void               ieee154e_setIsAckEnabled(bool isEnabled);
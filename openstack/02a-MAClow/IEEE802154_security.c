@@ -0,0 +1,127 @@
+#include "opendefs.h"
+#include "IEEE802154_security.h"
+#include "cryptoengine.h"
+#include "packetfunctions.h"
+#include "openserial.h"
+#include "sixtop.h"
+
+//=========================== defines =========================================
+
+// key of the network, shared by all its motes
+static const uint8_t IEEE802154_security_networkKey[CRYPTOENGINE_AES_BLOCK_LENGTH] = {
+   0xc0,0xc1,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,
+   0xc8,0xc9,0xca,0xcb,0xcc,0xcd,0xce,0xcf,
+};
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void IEEE802154_security_getNonce(uint8_t* nonce, OpenQueueEntry_t* msg, asn_t* asn);
+
+//=========================== public ==========================================
+
+/**
+\brief Load the network key into the crypto engine.
+
+Done once, so the per-frame cost is only the CCM* of the frame.
+*/
+void IEEE802154_security_init() {
+   if (CRYPTO_ENGINE.crypto_init((uint8_t*)IEEE802154_security_networkKey)!=E_SUCCESS) {
+      openserial_printCritical(COMPONENT_SECURITY,ERR_SECURITY,
+                               (errorparameter_t)0,
+                               (errorparameter_t)0);
+   }
+}
+
+/**
+\brief Append the MIC to a frame about to be transmitted.
+
+The whole frame (CRC excluded) is authenticated, not encrypted. Called from the
+TX data prepare, so it has to fit in maxTxDataPrepare.
+
+\param[in,out] msg The frame, without CRC.
+\param[in]     asn The ASN of the slot it is sent in.
+
+\returns E_SUCCESS, or E_FAIL if the crypto engine failed.
+*/
+owerror_t IEEE802154_security_outgoingFrame(OpenQueueEntry_t* msg, asn_t* asn) {
+   uint8_t nonce[CRYPTOENGINE_NONCE_LENGTH];
+   uint8_t len_a;
+
+   IEEE802154_security_getNonce(nonce,msg,asn);
+
+   len_a = msg->length;
+   packetfunctions_reserveFooterSize(msg,LENGTH_MIC);
+
+   if (CRYPTO_ENGINE.aes_ccms_mic(msg->payload,len_a,nonce,&msg->payload[len_a],LENGTH_MIC)!=E_SUCCESS) {
+      openserial_printError(COMPONENT_SECURITY,ERR_SECURITY,
+                            (errorparameter_t)msg->l2_frameType,
+                            (errorparameter_t)1);
+      return E_FAIL;
+   }
+   return E_SUCCESS;
+}
+
+/**
+\brief Check and remove the MIC of a received frame.
+
+\param[in,out] msg The frame, without CRC.
+\param[in]     asn The ASN of the slot it was received in.
+
+\returns E_SUCCESS if the frame is authentic, E_FAIL otherwise.
+*/
+owerror_t IEEE802154_security_incomingFrame(OpenQueueEntry_t* msg, asn_t* asn) {
+   uint8_t nonce[CRYPTOENGINE_NONCE_LENGTH];
+   uint8_t mic[CRYPTOENGINE_MAX_MIC_LENGTH];
+   uint8_t len_a;
+   uint8_t diff;
+   uint8_t i;
+
+   if (msg->length<sizeof(uint16_t)*2+LENGTH_MIC) {
+      return E_FAIL;
+   }
+
+   IEEE802154_security_getNonce(nonce,msg,asn);
+
+   len_a = msg->length-LENGTH_MIC;
+   if (CRYPTO_ENGINE.aes_ccms_mic(msg->payload,len_a,nonce,mic,LENGTH_MIC)!=E_SUCCESS) {
+      return E_FAIL;
+   }
+
+   // compare in constant time
+   diff = 0;
+   for (i=0;i<LENGTH_MIC;i++) {
+      diff |= mic[i]^msg->payload[len_a+i];
+   }
+   if (diff!=0) {
+      return E_FAIL;
+   }
+
+   packetfunctions_tossFooter(msg,LENGTH_MIC);
+   return E_SUCCESS;
+}
+
+//=========================== private =========================================
+
+/**
+\brief Build the CCM* nonce of a frame: its source address, then the ASN.
+
+The source is the short ID of the frame (eb_ht and light_ht share it), padded
+to 8 bytes. The ASN, most significant byte first, makes the nonce unique per
+slot, so a frame replayed in a later slot fails the check.
+*/
+void IEEE802154_security_getNonce(uint8_t* nonce, OpenQueueEntry_t* msg, asn_t* asn) {
+   uint8_t* src;
+
+   src = (uint8_t*)&((eb_ht*)msg->payload)->src;
+
+   memset(nonce,0,6);
+   nonce[6]  = src[0];
+   nonce[7]  = src[1];
+   nonce[8]  = asn->byte4;
+   nonce[9]  = (asn->bytes2and3/256 & 0xff);
+   nonce[10] = (asn->bytes2and3     & 0xff);
+   nonce[11] = (asn->bytes0and1/256 & 0xff);
+   nonce[12] = (asn->bytes0and1     & 0xff);
+}
@@ -0,0 +1,42 @@
+#ifndef __IEEE802154_SECURITY_H
+#define __IEEE802154_SECURITY_H
+
+/**
+\addtogroup MAClow
+\{
+\addtogroup IEEE802154_security
+\{
+*/
+
+#include "opendefs.h"
+
+//=========================== define ==========================================
+
+/// Length of the authentication tag appended to every EB and LIGHT frame.
+#ifdef L2_SECURITY_ACTIVE
+// the tag is computed in the TX prepare, a software AES on a slow MCU, e.g. the
+// MSP430 of the telosb, takes milliseconds and overruns it
+#ifndef BOARD_L2_SECURITY
+#error "l2_security=1 needs a board which authenticates a frame within maxTxDataPrepare, see BOARD_L2_SECURITY"
+#endif
+#define LENGTH_MIC                  4
+#else
+#define LENGTH_MIC                  0
+#endif
+
+//=========================== typedef =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void      IEEE802154_security_init(void);
+owerror_t IEEE802154_security_outgoingFrame(OpenQueueEntry_t* msg, asn_t* asn);
+owerror_t IEEE802154_security_incomingFrame(OpenQueueEntry_t* msg, asn_t* asn);
+
+/**
+\}
+\}
+*/
+
+#endif
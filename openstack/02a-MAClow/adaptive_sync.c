@@ -27,6 +27,11 @@
 
 adaptive_sync_vars_t adaptive_sync_vars;
 
+//=========================== prototypes ======================================
+
+void adaptive_sync_saveTimesource(void);
+void adaptive_sync_restoreTimesource(uint16_t timesource);
+
 //=========================== public ==========================================
 
 /**
@@ -47,18 +52,23 @@ void adaptive_sync_init() {
 \brief Calculate how many slots have elapsed since last synchronization.
 
 \param[in] timeCorrection    The time correction being applied.
-\param[in] timesource        The address of the neighbor with which I just
-   communicated, which triggered a time correction.
+\param[in] timesource        The short address of the neighbor with which I
+   just communicated, which triggered a time correction.
 */
-void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, open_addr_t timesource){
+void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, uint16_t timesource){
    uint8_t array[5];
    
    // stop calculating compensation period when compensateThreshold exceeds KATIMEOUT and drift is not changed
    if(
          adaptive_sync_vars.compensateThreshold  > MAXKAPERIOD &&
-         adaptive_sync_vars.driftChanged        == FALSE
+         adaptive_sync_vars.driftChanged        == FALSE      &&
+         ieee154e_isSynch()                                   &&
+         timesource == adaptive_sync_vars.compensationInfo_vars.neighborID
       ) {
-      if(timeCorrection > LIMITLARGETIMECORRECTION) {
+      if(
+            timeCorrection > LIMITLARGETIMECORRECTION ||
+            timeCorrection < -LIMITLARGETIMECORRECTION
+         ) {
          //once I get a large time correction, it means previous calcluated drift is not accurate yet. The clock drift is changed.
          adaptive_sync_driftChanged();
       }
@@ -69,7 +79,7 @@ void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, open_addr_t ti
    if(
          adaptive_sync_vars.driftChanged == FALSE &&
          ieee154e_isSynch()                       &&
-         packetfunctions_sameAddress(&timesource, &(adaptive_sync_vars.compensationInfo_vars.neighborID))
+         timesource == adaptive_sync_vars.compensationInfo_vars.neighborID
       ) {
          // only calcluate when asnDiff > compensateThresholdThreshold. (this is used for guaranteeing accuracy )
          if(ieee154e_asnDiff(&adaptive_sync_vars.oldASN) > adaptive_sync_vars.compensateThreshold) {
@@ -90,6 +100,9 @@ void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, open_addr_t ti
             adaptive_sync_vars.sumOfTC                    += timeCorrection;
          }
    } else {
+      // remember the drift estimated with the previous time source
+      adaptive_sync_saveTimesource();
+      
       adaptive_sync_vars.compensateThreshold               = BASIC_COMPENSATION_THRESHOLD;
 //      sixtop_setKaPeriod(adaptive_sync_vars.compensateThreshold);
       
@@ -99,6 +112,7 @@ void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, open_addr_t ti
       adaptive_sync_vars.compensationTimeout               = 0;
       adaptive_sync_vars.compensateTicks                   = 0;
       adaptive_sync_vars.sumOfTC                           = 0;
+      adaptive_sync_vars.driftChanged                      = FALSE;
       
       // update oldASN
       ieee154e_getAsn(array);
@@ -107,7 +121,11 @@ void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, open_addr_t ti
       adaptive_sync_vars.oldASN.byte4                      = array[4]; 
       
       // record this neighbor as my time source
-      memcpy(&(adaptive_sync_vars.compensationInfo_vars.neighborID), &timesource, sizeof(open_addr_t));
+      adaptive_sync_vars.compensationInfo_vars.neighborID  = timesource;
+      adaptive_sync_vars.compensationInfo_vars.compensationSlots = 0;
+      
+      // keep compensating with the drift estimated last time it was my time source, if any
+      adaptive_sync_restoreTimesource(timesource);
    }
 }
 
@@ -258,3 +276,77 @@ void adaptive_sync_driftChanged() {
    adaptive_sync_vars.driftChanged = TRUE;
 #endif
 }
+
+//=========================== private =========================================
+
+/**
+\brief Store the drift estimated with my current time source in the table.
+
+An estimate which is no longer trusted is dropped from the table, so it is not
+used again when this neighbor becomes my time source.
+*/
+void adaptive_sync_saveTimesource() {
+   uint8_t i;
+   uint8_t entry;
+   
+   // find the entry of this time source, else a free one
+   entry = ADAPTIVE_SYNC_NUMTIMESOURCES;
+   for (i=0;i<ADAPTIVE_SYNC_NUMTIMESOURCES;i++) {
+      if (
+            adaptive_sync_vars.timesources[i].used==TRUE &&
+            adaptive_sync_vars.timesources[i].compensationInfo.neighborID==adaptive_sync_vars.compensationInfo_vars.neighborID
+         ) {
+         entry = i;
+         break;
+      }
+      if (adaptive_sync_vars.timesources[i].used==FALSE && entry==ADAPTIVE_SYNC_NUMTIMESOURCES) {
+         entry = i;
+      }
+   }
+   
+   if (
+         adaptive_sync_vars.clockState   == S_NONE ||
+         adaptive_sync_vars.driftChanged == TRUE
+      ) {
+      if (entry<ADAPTIVE_SYNC_NUMTIMESOURCES) {
+         adaptive_sync_vars.timesources[entry].used = FALSE;
+      }
+      return;
+   }
+   
+   // table full, overwrite the entries in turn
+   if (entry==ADAPTIVE_SYNC_NUMTIMESOURCES) {
+      entry = adaptive_sync_vars.timesourceNext;
+      adaptive_sync_vars.timesourceNext = (adaptive_sync_vars.timesourceNext+1)%ADAPTIVE_SYNC_NUMTIMESOURCES;
+   }
+   
+   adaptive_sync_vars.timesources[entry].used                = TRUE;
+   adaptive_sync_vars.timesources[entry].compensationInfo    = adaptive_sync_vars.compensationInfo_vars;
+   adaptive_sync_vars.timesources[entry].clockState          = adaptive_sync_vars.clockState;
+   adaptive_sync_vars.timesources[entry].compensateThreshold = adaptive_sync_vars.compensateThreshold;
+}
+
+/**
+\brief Resume the compensation with the drift estimated earlier with a time source.
+
+The estimate keeps being refined from here, as compensation runs from the
+oldASN just recorded.
+
+\param[in] timesource The short address of my new time source.
+*/
+void adaptive_sync_restoreTimesource(uint16_t timesource) {
+   uint8_t i;
+   
+   for (i=0;i<ADAPTIVE_SYNC_NUMTIMESOURCES;i++) {
+      if (
+            adaptive_sync_vars.timesources[i].used==TRUE &&
+            adaptive_sync_vars.timesources[i].compensationInfo.neighborID==timesource
+         ) {
+         adaptive_sync_vars.compensationInfo_vars  = adaptive_sync_vars.timesources[i].compensationInfo;
+         adaptive_sync_vars.clockState             = adaptive_sync_vars.timesources[i].clockState;
+         adaptive_sync_vars.compensateThreshold    = adaptive_sync_vars.timesources[i].compensateThreshold;
+         adaptive_sync_vars.compensationTimeout    = adaptive_sync_vars.compensationInfo_vars.compensationSlots;
+         return;
+      }
+   }
+}
@@ -17,6 +17,8 @@
 
 //=========================== define ==========================================
 
+#define ADAPTIVE_SYNC_NUMTIMESOURCES  4 // number of time sources whose drift is remembered
+
 typedef enum {
    S_NONE          = 0x00,
    S_FASTER        = 0x01,
@@ -28,26 +30,35 @@ typedef enum {
 //=========================== module variables ================================
 
 typedef struct {
-   open_addr_t               neighborID;
+   uint16_t                  neighborID;              // short address of the time source
    uint16_t                  compensationSlots;       // compensation interval, in slots 
 } compensationInfo_t;
 
+typedef struct {
+   bool                      used;
+   compensationInfo_t        compensationInfo;
+   adaptive_sync_state_t     clockState;              // drift of my clock relative to this time source
+   uint16_t                  compensateThreshold;     // threshold reached with this time source
+} adaptive_sync_timesource_t;
+
 typedef struct {
    adaptive_sync_state_t     clockState;
    PORT_RADIOTIMER_WIDTH     elapsedSlots;            // since last synchronizatino, this number of slots have elapsed.
    uint16_t                  compensationTimeout;     // decrease one every slot, when it reach zero, adjust currectly slot length by 2 tick(60us). 
    uint16_t                  compensateTicks;         // record how many ticks  are compensated 
    asn_t                     oldASN;                  // the asn when synchronized previous time
-   compensationInfo_t        compensationInfo_vars;   // keep each time soures' compensation informatio( should be 9, since there would be more timesources)
+   compensationInfo_t        compensationInfo_vars;   // compensation information of my current time source
    int16_t                   sumOfTC;                 // record the sum of ticks between two time point which need to calculate compensation period.
    uint16_t                  compensateThreshold;     // number of slots. calculate the compensation period only when elapsed slot number is greater than this threshold 
    bool                      driftChanged;            // drift is changed or not.
+   adaptive_sync_timesource_t timesources[ADAPTIVE_SYNC_NUMTIMESOURCES]; // estimates kept across time source changes
+   uint8_t                   timesourceNext;          // entry overwritten when the table is full
 } adaptive_sync_vars_t;
 
 //=========================== prototypes ======================================
 
 void adaptive_sync_init(void);
-void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, open_addr_t timesource);
+void adaptive_sync_indicateTimeCorrection(int16_t timeCorrection, uint16_t timesource);
 void adaptive_sync_calculateCompensatedSlots(int16_t timeCorrection);
 
 void adaptive_sync_countCompensationTimeout(void);
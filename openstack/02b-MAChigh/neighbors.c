@@ -72,6 +72,50 @@ uint8_t neighbors_getNumNeighbors() {
    return returnVal;
 }
 
+/**
+\brief Pick the TX power of a frame, from how well my neighborhood hears me.
+
+With at least DENSENUMNEIGHBORS stable neighbors, my neighborhood is dense:
+EBs go out at DENSETXPOWER, the closest neighbors are enough to keep everyone
+synchronized and fewer concurrent flooders collide. Data goes out at
+DENSETXPOWER too, unless some downstream neighbor, with a larger DAGrank, is
+not stable: the flood may then not reach it, and data goes out at TX_POWER.
+
+The hysteresis between BADNEIGHBORMAXRSSI and GOODNEIGHBORMINRSSI is larger
+than the step down to DENSETXPOWER, so neighbors lowering their power do not
+make their links unstable, which would bring the power back up.
+
+\param[in] isEB TRUE for an EB, FALSE for data.
+
+\returns The l1_txPower of the frame.
+*/
+uint8_t neighbors_getTxPower(bool isEB) {
+   uint8_t i;
+   uint8_t numStable;
+   bool    weakDownstream;
+   
+   numStable      = 0;
+   weakDownstream = FALSE;
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      if (neighbors_vars.neighbors[i].used==FALSE) {
+         continue;
+      }
+      if (neighbors_vars.neighbors[i].stableNeighbor==TRUE) {
+         numStable++;
+      } else if (neighbors_vars.neighbors[i].DAGrank>neighbors_vars.myDAGrank) {
+         weakDownstream = TRUE;
+      }
+   }
+   
+   if (numStable<DENSENUMNEIGHBORS) {
+      return TX_POWER;
+   }
+   if (isEB==FALSE && weakDownstream==TRUE) {
+      return TX_POWER;
+   }
+   return DENSETXPOWER;
+}
+
 //===== interrogators
 
 /**
@@ -17,6 +17,8 @@
 #define BADNEIGHBORMAXRSSI        -70 // dBm
 #define GOODNEIGHBORMINRSSI       -80 // dBm
 #define SWITCHSTABILITYTHRESHOLD  3
+#define DENSENUMNEIGHBORS         AVERAGEDEGREE // stable neighbors making my neighborhood dense
+#define DENSETXPOWER              19 // l1_txPower in a dense neighborhood, -5dBm on the CC2420
 #define DEFAULTLINKCOST           15
 
 #define MAXDAGRANK                0xff
@@ -73,6 +75,7 @@ void          neighbors_init(void);
 // getters
 dagrank_t     neighbors_getMyDAGrank(void);
 uint8_t       neighbors_getNumNeighbors(void);
+uint8_t       neighbors_getTxPower(bool isEB);
 
 // interrogators
 bool          neighbors_isStableNeighbor(uint16_t shortID);
@@ -230,6 +230,30 @@ slotOffset_t schedule_getNextActiveSlotOffset() {
    return res;
 }
 
+/**
+\brief Get the number of active slots in the schedule.
+
+\returns The number of schedule entries which are not of type CELLTYPE_OFF.
+*/
+uint8_t schedule_getNumActiveSlots() {
+   uint8_t i;
+   uint8_t numActive;
+   
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   numActive = 0;
+   for (i=0;i<MAXACTIVESLOTS;i++) {
+      if (schedule_vars.scheduleBuf[i].type!=CELLTYPE_OFF) {
+         numActive++;
+      }
+   }
+   
+   ENABLE_INTERRUPTS();
+   
+   return numActive;
+}
+
 /**
 \brief Get the type of the current schedule entry.
 
@@ -82,6 +82,7 @@ owerror_t          schedule_addActiveSlot(
 void               schedule_syncSlotOffset(slotOffset_t targetSlotOffset);
 void               schedule_advanceSlot(void);
 slotOffset_t       schedule_getNextActiveSlotOffset(void);
+uint8_t            schedule_getNumActiveSlots(void);
 cellType_t         schedule_getType(void);
 channelOffset_t    schedule_getChannelOffset(void);
 
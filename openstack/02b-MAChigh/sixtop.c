@@ -20,13 +20,22 @@
 
 //=========================== variables =======================================
 
+sixtop_vars_t sixtop_vars;
+
 //=========================== prototypes ======================================
 
 owerror_t     sixtop_send_internal(OpenQueueEntry_t* msg);
+bool          sixtop_ebTrickleFired(void);
+void          sixtop_ebTrickleNewInterval(void);
+void          sixtop_ebTrickleRx(eb_ht* eb);
 
 //=========================== public ==========================================
 
 void sixtop_init() {
+   memset(&sixtop_vars,0,sizeof(sixtop_vars_t));
+   
+   sixtop_vars.ebInterval = SIXTOP_EB_IMIN;
+   sixtop_ebTrickleNewInterval();
 }
 
 //======= from upper layer
@@ -44,15 +53,18 @@ owerror_t sixtop_send(OpenQueueEntry_t *msg) {
 //======= from lower layer
 
 /**
-\brief Send an EB.
+\brief Send an EB, if the Trickle timer of the EBs fires.
 
-This is one of the MAC management tasks. This function inlines in the
-timers_res_fired() function, but is declared as a separate function for better
-readability of the code.
+The MAC calls this function at the start of every EB cell, in ISR context.
 */
 port_INLINE void sixtop_sendEB(void) {
    OpenQueueEntry_t* eb;
    
+   if (sixtop_ebTrickleFired()==FALSE) {
+      // not my turn, or my neighbors already sent enough EBs
+      return;
+   }
+   
    if (neighbors_getMyDAGrank()==DEFAULTDAGRANK){
       // I have not acquired a DAGrank yet
       
@@ -81,7 +93,7 @@ port_INLINE void sixtop_sendEB(void) {
    ((eb_ht*)(eb->payload))->type            = LONGTYPE_BEACON;
    ((eb_ht*)(eb->payload))->src             = idmanager_getMyShortID();
    ((eb_ht*)(eb->payload))->ebrank          = (uint8_t)neighbors_getMyDAGrank();
-   ((eb_ht*)(eb->payload))->light_info      = light_get_light_info(0);
+   light_getDigest(((eb_ht*)(eb->payload))->light_digest);
    
    // remember where to write the ASN to
    eb->l2_ASNpayload                        = (uint8_t*)(&((eb_ht*)(eb->payload))->asn0);
@@ -96,96 +108,113 @@ port_INLINE void sixtop_sendEB(void) {
    sixtop_send_internal(eb);
 }
 
-void task_sixtopNotifSendDone(void) {
-   OpenQueueEntry_t* msg;
+/**
+\brief Restart the Trickle timer of the EBs from its smallest interval.
+
+Called when something my EBs advertise changed: a new syncnum, a new burst.
+Can be called from ISR or task context.
+*/
+void sixtop_resetEBTrickle(void) {
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
    
-   // get recently-sent packet from openqueue
-   msg = openqueue_sixtopGetSentPacket();
-   if (msg==NULL) {
-      openserial_printCritical(
-         COMPONENT_SIXTOP,
-         ERR_NO_SENT_PACKET,
-         (errorparameter_t)0,
-         (errorparameter_t)0
-      );
-      return;
+   if (sixtop_vars.ebInterval!=SIXTOP_EB_IMIN) {
+      sixtop_vars.ebInterval = SIXTOP_EB_IMIN;
+      sixtop_ebTrickleNewInterval();
    }
    
-   // take ownership
-   msg->owner = COMPONENT_SIXTOP;
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Process all packets the MAC has finished sending.
+
+The MAC only posts this task when no sent packet was already waiting, so a
+single run drains every pending packet, oldest first. A run may find the queue
+empty when a previous run already picked up the packet which posted it.
+*/
+void task_sixtopNotifSendDone(void) {
+   OpenQueueEntry_t* msg;
    
-   // send the packet to where it belongs
-   switch (msg->creator) {
+   // get recently-sent packets from openqueue, oldest first
+   while ((msg = openqueue_sixtopGetSentPacket())!=NULL) {
       
-      case COMPONENT_SIXTOP:
-         // this is a EB
-            
-         // discard packets
-         openqueue_freePacketBuffer(msg);
-         
-         break;
-  
-      case COMPONENT_LIGHT:
-         // this is a data packet
+      // take ownership
+      msg->owner = COMPONENT_SIXTOP;
+      
+      // send the packet to where it belongs
+      switch (msg->creator) {
          
-         light_sendDone(msg,msg->l2_sendDoneError);
-         break;
+         case COMPONENT_SIXTOP:
+            // this is a EB
+            
+            // discard packets
+            openqueue_freePacketBuffer(msg);
+            
+            break;
          
-      default:
-         // send the rest up the stack
-         break;
+         case COMPONENT_LIGHT:
+            // this is a data packet
+            
+            light_sendDone(msg,msg->l2_sendDoneError);
+            break;
+            
+         default:
+            // send the rest up the stack
+            break;
+      }
    }
 }
 
+/**
+\brief Process all packets the MAC has received.
+
+The MAC only posts this task when no received packet was already waiting, so a
+single run drains every pending packet in arrival order. A run may find the
+queue empty when a previous run already picked up the packet which posted it.
+*/
 void task_sixtopNotifReceive(void) {
    OpenQueueEntry_t*    msg;
    eb_ht*               eb;
    
-   // get received packet from openqueue
-   msg = openqueue_sixtopGetReceivedPacket();
-   if (msg==NULL) {
-      openserial_printCritical(
-         COMPONENT_SIXTOP,
-         ERR_NO_RECEIVED_PACKET,
-         (errorparameter_t)0,
-         (errorparameter_t)0
+   // get received packets from openqueue, oldest first
+   while ((msg = openqueue_sixtopGetReceivedPacket())!=NULL) {
+      
+      // take ownership
+      msg->owner = COMPONENT_SIXTOP;
+      
+      // parse as if it's an EB (light_ht and eb_ht) start with the same bytes
+      eb = (eb_ht*)msg->payload;
+      
+      // update neighbor statistics
+      neighbors_indicateRx(
+         eb->src,
+         msg->l1_rssi,
+         &msg->l2_asn
       );
-      return;
-   }
-   
-   // take ownership
-   msg->owner = COMPONENT_SIXTOP;
-   
-   // parse as if it's an EB (light_ht and eb_ht) start with the same bytes
-   eb = (eb_ht*)msg->payload;
-   
-   // update neighbor statistics
-   neighbors_indicateRx(
-      eb->src,
-      msg->l1_rssi,
-      &msg->l2_asn
-   );
-   
-   // send the packet up the stack, if it qualifies
-   switch (*((uint16_t*)(msg->payload))) {
-      case LONGTYPE_BEACON:
-         neighbors_indicateRxEB(msg);
-         light_receive_beacon(msg);
-         break;
-      case LONGTYPE_DATA:
-        light_receive_data(msg);
-        break;
-      default:
-         // free the packet's RAM memory
-         openqueue_freePacketBuffer(msg);
-         // log the error
-         openserial_printError(
-            COMPONENT_SIXTOP,
-            ERR_MSG_UNKNOWN_TYPE,
-            (errorparameter_t)msg->l2_frameType,
-            (errorparameter_t)0
-         );
-         break;
+      
+      // send the packet up the stack, if it qualifies
+      switch (*((uint16_t*)(msg->payload))) {
+         case LONGTYPE_BEACON:
+            sixtop_ebTrickleRx(eb);
+            neighbors_indicateRxEB(msg);
+            light_receive_beacon(msg);
+            break;
+         case LONGTYPE_DATA:
+            light_receive_data(msg);
+            break;
+         default:
+            // log the error
+            openserial_printError(
+               COMPONENT_SIXTOP,
+               ERR_MSG_UNKNOWN_TYPE,
+               (errorparameter_t)msg->l2_frameType,
+               (errorparameter_t)0
+            );
+            // free the packet's RAM memory
+            openqueue_freePacketBuffer(msg);
+            break;
+      }
    }
 }
 
@@ -211,6 +240,85 @@ bool debugPrint_myDAGrank(void) {
 
 //=========================== private =========================================
 
+/**
+\brief Advance the Trickle timer of the EBs by one EB cell.
+
+Runs in ISR context, from sixtop_sendEB().
+
+The neighbors whose EBs suppress mine may not be heard by my children, which
+only take a new syncnum from their preferred parent. Whatever I hear, I send at
+least one EB every SIXTOP_EB_IMAX EB cells, so they never wait longer than at
+the largest interval.
+
+\returns TRUE iff I should send an EB in this cell.
+*/
+port_INLINE bool sixtop_ebTrickleFired(void) {
+   bool fired;
+   
+   fired = (
+      sixtop_vars.ebElapsed==sixtop_vars.ebSendAt &&
+      sixtop_vars.ebNumConsistent<SIXTOP_EB_REDUNDANCY
+   );
+   
+   // suppressed for too long
+   if (sixtop_vars.ebSinceSent>=SIXTOP_EB_IMAX-1) {
+      fired = TRUE;
+   }
+   if (fired==TRUE) {
+      sixtop_vars.ebSinceSent = 0;
+   } else {
+      sixtop_vars.ebSinceSent++;
+   }
+   
+   sixtop_vars.ebElapsed++;
+   if (sixtop_vars.ebElapsed>=sixtop_vars.ebInterval) {
+      // interval over, double it
+      if (sixtop_vars.ebInterval<SIXTOP_EB_IMAX/2) {
+         sixtop_vars.ebInterval *= 2;
+      } else {
+         sixtop_vars.ebInterval  = SIXTOP_EB_IMAX;
+      }
+      sixtop_ebTrickleNewInterval();
+   }
+   
+   return fired;
+}
+
+/**
+\brief Start a Trickle interval, sending at a random cell of its second half.
+*/
+port_INLINE void sixtop_ebTrickleNewInterval(void) {
+   sixtop_vars.ebElapsed         = 0;
+   sixtop_vars.ebNumConsistent   = 0;
+   sixtop_vars.ebSendAt          = sixtop_vars.ebInterval/2+
+                                   openrandom_get16b()%(sixtop_vars.ebInterval/2);
+}
+
+/**
+\brief Account for an EB heard from a neighbor.
+
+An EB with another syncnum than mine is inconsistent and restarts the timer.
+One with my syncnum and my rank advertises what mine would, and counts towards
+suppressing it.
+
+\param[in] eb The EB received.
+*/
+void sixtop_ebTrickleRx(eb_ht* eb) {
+   if (eb->syncnum!=ieee154e_getSyncnum()) {
+      sixtop_resetEBTrickle();
+      return;
+   }
+   
+   if (eb->ebrank==(uint8_t)neighbors_getMyDAGrank()) {
+      INTERRUPT_DECLARATION();
+      DISABLE_INTERRUPTS();
+      if (sixtop_vars.ebNumConsistent<0xff) {
+         sixtop_vars.ebNumConsistent++;
+      }
+      ENABLE_INTERRUPTS();
+   }
+}
+
 /**
 \brief Transfer packet to MAC.
 
@@ -232,8 +340,8 @@ owerror_t sixtop_send_internal(OpenQueueEntry_t* msg) {
    msg->l2_retriesLeft = 1;
    // this is a new packet which I never attempted to send
    msg->l2_numTxAttempts = 0;
-   // transmit with the default TX power
-   msg->l1_txPower = TX_POWER;
+   // transmit with the TX power my neighborhood allows
+   msg->l1_txPower = neighbors_getTxPower(msg->l2_frameType==IEEE154_TYPE_BEACON);
    // change owner to IEEE802154E fetches it from queue
    msg->owner  = COMPONENT_SIXTOP_TO_IEEE802154E;
    return E_SUCCESS;
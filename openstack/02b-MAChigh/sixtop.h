@@ -11,6 +11,7 @@
 #include "opentimers.h"
 #include "opendefs.h"
 #include "processIE.h"
+#include "light.h"
 
 //=========================== define ==========================================
 
@@ -56,17 +57,29 @@ typedef struct {                                 // always written big endian, i
    uint8_t   asn1;
    uint8_t   asn2;
    uint8_t   asn3;
-   uint8_t   light_info;
+   uint8_t   light_digest[LIGHT_DIGEST_LENGTH]; // latest bursts of some of the sensors, see light_getDigest()
 } eb_ht;
 END_PACK
 
 //=========================== typedef =========================================
 
 #define SIX2SIX_TIMEOUT_MS 4000
-#define SIXTOP_MINIMAL_EBPERIOD 5 // minist period of sending EB
+
+// Trickle timer of the EBs, in EB cells
+#define SIXTOP_EB_IMIN          4 // smallest interval: the EB cell visits each EB channel once
+#define SIXTOP_EB_IMAX         64 // largest interval, keeps the DAGroot's syncnum well within DESYNCTIMEOUT
+#define SIXTOP_EB_REDUNDANCY    2 // number of consistent EBs heard which suppress mine
 
 //=========================== module variables ================================
 
+typedef struct {
+   uint8_t   ebInterval;      // current Trickle interval, in EB cells
+   uint8_t   ebElapsed;       // EB cells elapsed in the current interval
+   uint8_t   ebSendAt;        // EB cell of the current interval at which I send
+   uint8_t   ebNumConsistent; // consistent EBs heard in the current interval
+   uint8_t   ebSinceSent;     // EB cells since I last sent, or was due to send, an EB
+} sixtop_vars_t;
+
 //=========================== prototypes ======================================
 
 // admin
@@ -75,6 +88,7 @@ void      sixtop_init(void);
 owerror_t sixtop_send(OpenQueueEntry_t *msg);
 // from lower layer
 void      sixtop_sendEB(void);
+void      sixtop_resetEBTrickle(void);
 void      task_sixtopNotifSendDone(void);
 void      task_sixtopNotifReceive(void);
 // debugging
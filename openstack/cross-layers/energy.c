@@ -0,0 +1,271 @@
+#include "opendefs.h"
+#include "energy.h"
+#include "radio.h"
+#include "openserial.h"
+
+//=========================== variables =======================================
+
+energy_vars_t energy_vars;
+
+static const uint16_t energy_txCurrent[ENERGY_NUM_TXPOWERS] = BOARD_CURRENT_TX_UA;
+
+//=========================== prototypes ======================================
+
+uint32_t energy_now(void);
+void     energy_chargeCpu(uint32_t now);
+void     energy_chargeRadio(uint32_t now);
+void     energy_add(uint8_t budget, uint8_t load, uint16_t current, uint32_t ticks);
+uint32_t energy_budgetCharge(uint8_t budget);
+
+//=========================== public ==========================================
+
+/**
+\brief Initialize this module.
+
+The meter runs on the timer of the MAC, which the MAC keeps counting slots on
+while the CPU sleeps, and starts with the CPU active and the radio off.
+*/
+void energy_init() {
+   memset(&energy_vars,0,sizeof(energy_vars_t));
+   energy_vars.budget      = ENERGY_BUDGET_IDLE;
+   energy_vars.cpuActive   = TRUE;
+   energy_vars.cpuStamp    = energy_now();
+}
+
+/**
+\brief A new slot started, the timer of the MAC wrapped.
+
+Called first thing in the new slot interrupt, before anything reads the time.
+
+\param[in] period The length of the slot which ended, in ticks.
+*/
+void energy_newSlot(PORT_RADIOTIMER_WIDTH period) {
+   energy_vars.epoch += period;
+}
+
+/**
+\brief The CPU woke up, for the MAC.
+
+Called when entering the interrupts of the MAC. The CPU is charged as asleep
+until then, including the interrupts and tasks of the other modules.
+*/
+void energy_wakeup() {
+   if (energy_vars.cpuActive==TRUE) {
+      return;
+   }
+   energy_chargeCpu(energy_now());
+   energy_vars.cpuActive = TRUE;
+}
+
+/**
+\brief The MAC is done, the CPU can go back to sleep.
+
+Called when leaving the interrupts of the MAC.
+*/
+void energy_sleep() {
+   if (energy_vars.cpuActive==FALSE) {
+      return;
+   }
+   energy_chargeCpu(energy_now());
+   energy_vars.cpuActive = FALSE;
+}
+
+/**
+\brief Charge the CPU, active or asleep, to another budget from now on.
+
+\param[in] budget The new budget, an energy_budget_t.
+*/
+void energy_setBudget(uint8_t budget) {
+   if (budget==energy_vars.budget) {
+      return;
+   }
+   energy_chargeCpu(energy_now());
+   energy_vars.budget = budget;
+}
+
+/**
+\brief The radio was switched on, for the current budget.
+
+Switching it on again, e.g. on another channel, charges what it drew so far.
+
+\param[in] load    ENERGY_LOAD_RX or ENERGY_LOAD_TX.
+\param[in] txPower The l1_txPower of the frame, ignored in RX.
+*/
+void energy_radioOn(uint8_t load, uint8_t txPower) {
+   uint32_t         now;
+
+   now = energy_now();
+   if (energy_vars.radioOn==TRUE) {
+      energy_chargeRadio(now);
+   }
+   energy_vars.radioOn       = TRUE;
+   energy_vars.radioBudget   = energy_vars.budget;
+   energy_vars.radioLoad     = load;
+   if (load==ENERGY_LOAD_TX) {
+      energy_vars.radioCurrent = energy_txCurrent[(txPower>>2)&(ENERGY_NUM_TXPOWERS-1)];
+   } else {
+      energy_vars.radioCurrent = BOARD_CURRENT_RX_UA;
+   }
+   energy_vars.radioStamp    = now;
+}
+
+/**
+\brief The radio was switched off.
+*/
+void energy_radioOff() {
+   if (energy_vars.radioOn==FALSE) {
+      return;
+   }
+   energy_chargeRadio(energy_now());
+   energy_vars.radioOn = FALSE;
+}
+
+/**
+\brief This mote heard of a new burst, the previous one ends.
+
+The charge of each burst is what all budgets drew from its first reception to
+that of the next burst, whichever sensor the next one comes from.
+
+\param[in] origin  The sensor which generated the new burst.
+\param[in] burstId Its burst ID.
+*/
+void energy_newBurst(uint16_t origin, uint8_t burstId) {
+   uint32_t         now;
+   uint32_t         floodCharge;
+   uint32_t         totalCharge;
+   uint8_t          budget;
+   INTERRUPT_DECLARATION();
+
+   DISABLE_INTERRUPTS();
+
+   // bring the charges up to now
+   now = energy_now();
+   energy_chargeCpu(now);
+   if (energy_vars.radioOn==TRUE) {
+      energy_chargeRadio(now);
+   }
+
+   floodCharge = energy_budgetCharge(ENERGY_BUDGET_FLOOD);
+   totalCharge = 0;
+   for (budget=0;budget<ENERGY_BUDGET_MAX;budget++) {
+      totalCharge += energy_budgetCharge(budget);
+   }
+
+   // close the burst in progress
+   if (energy_vars.burst.origin!=0) {
+      energy_vars.status.lastBurst.origin       = energy_vars.burst.origin;
+      energy_vars.status.lastBurst.burstId      = energy_vars.burst.burstId;
+      energy_vars.status.lastBurst.floodCharge  = floodCharge-energy_vars.burst.floodCharge;
+      energy_vars.status.lastBurst.totalCharge  = totalCharge-energy_vars.burst.totalCharge;
+   }
+
+   // open the new one
+   energy_vars.burst.origin       = origin;
+   energy_vars.burst.burstId      = burstId;
+   energy_vars.burst.floodCharge  = floodCharge;
+   energy_vars.burst.totalCharge  = totalCharge;
+
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Trigger this module to print status information, over serial.
+
+debugPrint_* functions are used by the openserial module to continuously print
+status information about several modules in the OpenWSN stack.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_energy() {
+   energy_status_t  output;
+   uint32_t         now;
+   INTERRUPT_DECLARATION();
+
+   // bring the charges up to now, the MAC charges from its interrupts
+   DISABLE_INTERRUPTS();
+   now = energy_now();
+   energy_chargeCpu(now);
+   if (energy_vars.radioOn==TRUE) {
+      energy_chargeRadio(now);
+   }
+   memcpy(&output,&energy_vars.status,sizeof(energy_status_t));
+   ENABLE_INTERRUPTS();
+
+   openserial_printStatus(STATUS_ENERGY,(uint8_t*)&output,sizeof(energy_status_t));
+   return TRUE;
+}
+
+//=========================== private =========================================
+
+/**
+\brief Ticks since boot, on the timeline of the MAC.
+*/
+uint32_t energy_now() {
+   return energy_vars.epoch+radio_getTimerValue();
+}
+
+/**
+\brief Charge the CPU for the time since its last charge.
+*/
+void energy_chargeCpu(uint32_t now) {
+   if ((int32_t)(now-energy_vars.cpuStamp)<=0) {
+      // the timer wrapped and the new slot interrupt did not run yet
+      return;
+   }
+   if (energy_vars.cpuActive==TRUE) {
+      energy_add(energy_vars.budget,ENERGY_LOAD_CPU,BOARD_CURRENT_CPU_UA,now-energy_vars.cpuStamp);
+   } else {
+      energy_add(energy_vars.budget,ENERGY_LOAD_SLEEP,BOARD_CURRENT_SLEEP_UA,now-energy_vars.cpuStamp);
+   }
+   energy_vars.cpuStamp = now;
+}
+
+/**
+\brief Charge the radio, which is on, for the time since its last charge.
+*/
+void energy_chargeRadio(uint32_t now) {
+   if ((int32_t)(now-energy_vars.radioStamp)<=0) {
+      return;
+   }
+   energy_add(energy_vars.radioBudget,energy_vars.radioLoad,energy_vars.radioCurrent,now-energy_vars.radioStamp);
+   energy_vars.radioStamp = now;
+}
+
+/**
+\brief Add the charge of a current over some ticks.
+
+The uA.ticks which do not make a whole uC are carried over to the next call,
+so short intervals, e.g. the CPU in a slot, add up without rounding.
+
+\param[in] budget  The budget to charge.
+\param[in] load    What drew the current.
+\param[in] current The current, in uA.
+\param[in] ticks   How long it was drawn.
+*/
+void energy_add(uint8_t budget, uint8_t load, uint16_t current, uint32_t ticks) {
+   uint32_t chunk;
+   uint32_t acc;
+
+   // one second at a time, so the product fits 32 bits
+   while (ticks>0) {
+      chunk  = (ticks>ENERGY_TICKS_PER_S) ? ENERGY_TICKS_PER_S : ticks;
+      acc    = (uint32_t)current*chunk+energy_vars.remainder[budget][load];
+      energy_vars.status.charge[budget][load] += acc/ENERGY_TICKS_PER_S;
+      energy_vars.remainder[budget][load]      = acc%ENERGY_TICKS_PER_S;
+      ticks -= chunk;
+   }
+}
+
+/**
+\brief Charge drawn by all the loads of a budget, in uC.
+*/
+uint32_t energy_budgetCharge(uint8_t budget) {
+   uint32_t total;
+   uint8_t  load;
+
+   total = 0;
+   for (load=0;load<ENERGY_LOAD_MAX;load++) {
+      total += energy_vars.status.charge[budget][load];
+   }
+   return total;
+}
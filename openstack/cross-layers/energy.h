@@ -0,0 +1,103 @@
+#ifndef __ENERGY_H
+#define __ENERGY_H
+
+/**
+\addtogroup cross-layers
+\{
+\addtogroup Energy
+\{
+*/
+
+#include "opendefs.h"
+
+//=========================== define ==========================================
+
+/// Ticks per second of the timer of the MAC, which the meter reads.
+#define ENERGY_TICKS_PER_S          32768
+
+/// Number of entries of BOARD_CURRENT_TX_UA, l1_txPower>>2 indexes it.
+#define ENERGY_NUM_TXPOWERS         8
+
+//=========================== typedef =========================================
+
+/**
+\brief What the charge is spent on.
+
+The MAC sets the budget at the start of each slot and around the serial
+windows, the charge of the CPU and of the radio goes to the budget set when
+they were switched on.
+*/
+typedef enum {
+   ENERGY_BUDGET_EB          = 0,   ///< EB cells
+   ENERGY_BUDGET_FLOOD       = 1,   ///< TXRX cells, carrying the LIGHT flood
+   ENERGY_BUDGET_SYNC        = 2,   ///< listening for EBs, while not synchronized
+   ENERGY_BUDGET_SERIAL      = 3,   ///< preparing the serial windows and the flash log
+   ENERGY_BUDGET_IDLE        = 4,   ///< everything else, e.g. the slots without a cell
+   ENERGY_BUDGET_MAX         = 5,
+} energy_budget_t;
+
+/**
+\brief Who draws the charge.
+*/
+typedef enum {
+   ENERGY_LOAD_CPU           = 0,   ///< CPU active
+   ENERGY_LOAD_SLEEP         = 1,   ///< CPU asleep
+   ENERGY_LOAD_RX            = 2,   ///< radio receiving, or listening
+   ENERGY_LOAD_TX            = 3,   ///< radio transmitting, at l1_txPower
+   ENERGY_LOAD_MAX           = 4,
+} energy_load_t;
+
+BEGIN_PACK
+typedef struct {
+   uint16_t                  origin;          // sensor which generated the burst, 0 before the first one
+   uint8_t                   burstId;
+   uint32_t                  floodCharge;     // uC charged to ENERGY_BUDGET_FLOOD during the burst
+   uint32_t                  totalCharge;     // uC charged to all budgets during the burst
+} energy_burst_t;
+END_PACK
+
+BEGIN_PACK
+typedef struct {
+   uint32_t                  charge[ENERGY_BUDGET_MAX][ENERGY_LOAD_MAX]; // uC, since boot
+   energy_burst_t            lastBurst;       // the last burst which ended
+} energy_status_t;
+END_PACK
+
+//=========================== module variables ================================
+
+typedef struct {
+   energy_status_t           status;
+   uint16_t                  remainder[ENERGY_BUDGET_MAX][ENERGY_LOAD_MAX]; // uA.ticks not yet making a whole uC
+   uint32_t                  epoch;           // ticks from boot to the start of the current slot
+   // CPU
+   uint8_t                   budget;          // the CPU works, or sleeps, for this budget
+   bool                      cpuActive;
+   uint32_t                  cpuStamp;        // when the CPU was last charged for
+   // radio
+   bool                      radioOn;
+   uint8_t                   radioBudget;     // the budget which switched the radio on
+   uint8_t                   radioLoad;       // ENERGY_LOAD_RX or ENERGY_LOAD_TX
+   uint16_t                  radioCurrent;    // uA, on top of the CPU's
+   uint32_t                  radioStamp;      // when the radio was last charged for
+   // bursts
+   energy_burst_t            burst;           // the burst in progress, its charges taken at its start
+} energy_vars_t;
+
+//=========================== prototypes ======================================
+
+void     energy_init(void);
+void     energy_newSlot(PORT_RADIOTIMER_WIDTH period);
+void     energy_wakeup(void);
+void     energy_sleep(void);
+void     energy_setBudget(uint8_t budget);
+void     energy_radioOn(uint8_t load, uint8_t txPower);
+void     energy_radioOff(void);
+void     energy_newBurst(uint16_t origin, uint8_t burstId);
+bool     debugPrint_energy(void);
+
+/**
+\}
+\}
+*/
+
+#endif
@@ -11,6 +11,7 @@ openqueue_vars_t openqueue_vars;
 //=========================== prototypes ======================================
 
 void openqueue_reset_entry(OpenQueueEntry_t* entry);
+bool openqueue_isOlder(OpenQueueEntry_t* entry, OpenQueueEntry_t* other);
 
 //=========================== public ==========================================
 
@@ -155,34 +156,56 @@ void openqueue_removeAllOwnedBy(uint8_t owner) {
 
 //======= called by RES
 
+/**
+\brief Retrieve the oldest packet the MAC has finished sending.
+
+When several packets are waiting, the one with the lowest l2_asn is returned,
+so that sixtop processes send-done notifications in the order they happened.
+
+\returns A pointer to the packet, or NULL if none is waiting.
+*/
 OpenQueueEntry_t* openqueue_sixtopGetSentPacket() {
+   OpenQueueEntry_t* oldest;
    uint8_t i;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
+   oldest = NULL;
    for (i=0;i<QUEUELENGTH;i++) {
       if (openqueue_vars.queue[i].owner==COMPONENT_IEEE802154E_TO_SIXTOP &&
           openqueue_vars.queue[i].creator!=COMPONENT_IEEE802154E) {
-         ENABLE_INTERRUPTS();
-         return &openqueue_vars.queue[i];
+         if (oldest==NULL || openqueue_isOlder(&openqueue_vars.queue[i],oldest)) {
+            oldest = &openqueue_vars.queue[i];
+         }
       }
    }
    ENABLE_INTERRUPTS();
-   return NULL;
+   return oldest;
 }
 
+/**
+\brief Retrieve the oldest packet the MAC has received.
+
+When several packets are waiting, the one with the lowest l2_asn is returned,
+so that sixtop processes receptions in arrival order.
+
+\returns A pointer to the packet, or NULL if none is waiting.
+*/
 OpenQueueEntry_t* openqueue_sixtopGetReceivedPacket() {
+   OpenQueueEntry_t* oldest;
    uint8_t i;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
+   oldest = NULL;
    for (i=0;i<QUEUELENGTH;i++) {
       if (openqueue_vars.queue[i].owner==COMPONENT_IEEE802154E_TO_SIXTOP &&
           openqueue_vars.queue[i].creator==COMPONENT_IEEE802154E) {
-         ENABLE_INTERRUPTS();
-         return &openqueue_vars.queue[i];
+         if (oldest==NULL || openqueue_isOlder(&openqueue_vars.queue[i],oldest)) {
+            oldest = &openqueue_vars.queue[i];
+         }
       }
    }
    ENABLE_INTERRUPTS();
-   return NULL;
+   return oldest;
 }
 
 //======= called by IEEE80215E
@@ -219,6 +242,24 @@ OpenQueueEntry_t* openqueue_macGetEBPacket() {
 
 //=========================== private =========================================
 
+/**
+\brief Tell whether a packet was handled by the MAC before another one.
+
+\param[in] entry  The packet to test.
+\param[in] other  The packet to compare against.
+
+\returns TRUE if entry's l2_asn is strictly lower than other's.
+*/
+bool openqueue_isOlder(OpenQueueEntry_t* entry, OpenQueueEntry_t* other) {
+   if (entry->l2_asn.byte4 != other->l2_asn.byte4) {
+      return entry->l2_asn.byte4 < other->l2_asn.byte4;
+   }
+   if (entry->l2_asn.bytes2and3 != other->l2_asn.bytes2and3) {
+      return entry->l2_asn.bytes2and3 < other->l2_asn.bytes2and3;
+   }
+   return entry->l2_asn.bytes0and1 < other->l2_asn.bytes0and1;
+}
+
 void openqueue_reset_entry(OpenQueueEntry_t* entry) {
    //admin
    entry->creator                      = COMPONENT_NULL;
@@ -7,15 +7,18 @@
 #include "opendefs.h"
 //===== drivers
 #include "openserial.h"
+#include "flashlog.h"
 //===== stack
 #include "openstack.h"
 //-- cross-layer
 #include "idmanager.h"
 #include "openqueue.h"
 #include "openrandom.h"
+#include "energy.h"
 #include "opentimers.h"
 //-- 02a-TSCH
 #include "adaptive_sync.h"
+#include "IEEE802154_security.h"
 #include "IEEE802154E.h"
 //-- 02b-RES
 #include "schedule.h"
@@ -35,6 +38,7 @@
 void openstack_init(void) {
    
    //===== drivers
+   flashlog_init();     // before the first print, and before the MAC runs as it may erase
    openserial_init();
    
    //===== stack
@@ -43,8 +47,12 @@ void openstack_init(void) {
    openqueue_init();
    openrandom_init();
    opentimers_init();
+   energy_init();       // after opentimers, which may reset the timer it reads
    //-- 02a-TSCH
    adaptive_sync_init();
+#ifdef L2_SECURITY_ACTIVE
+   IEEE802154_security_init();
+#endif
    ieee154e_init();
    //-- 02b-RES
    schedule_init();
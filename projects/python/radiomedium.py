@@ -0,0 +1,273 @@
+#!/usr/bin/python
+'''
+Radio medium for the python simulator.
+
+The firmware compiled for the python board (oos_openwsn) hands every radio
+operation to Python callbacks: radio_setFrequency, radio_setTxPower,
+radio_txNow, radio_rxNow. The simulator collects, for each slot, which motes
+transmit and which listen, on which channel, and asks a RadioMedium which frame,
+if any, each listener receives.
+
+The link budget of a slot is computed for all listener/transmitter pairs at
+once, with numpy, so hundreds of motes with dense neighborhoods stay fast:
+- log-distance path loss, PL(d) = PL(d0) + 10.n.log10(d/d0)
+- log-normal shadowing, the same both ways of a link, plus a smaller part drawn
+  for each direction, so links are asymmetric
+- Rayleigh or Rician fading, drawn for each frame
+- interference sources on some channels, e.g. a WiFi access point, active in a
+  fraction of the slots
+
+A listener locks on the strongest frame on its channel. It receives it when its
+power is above the sensitivity and its SINR, against the noise, the other
+frames on that channel and the interferers, is above the capture threshold. In
+TSCH all the frames of a slot start TsTxOffset into it, so locking on the
+strongest one is what the radio does.
+
+Works with Python 2.7 and Python 3, needs numpy.
+'''
+
+import argparse
+import time
+
+import numpy as np
+
+#============================ defines =========================================
+
+FADING_NONE               = 'none'
+FADING_RAYLEIGH           = 'rayleigh'
+FADING_RICIAN             = 'rician'
+
+DEFAULT_PATHLOSS_D0       = 1.0      # m, reference distance
+DEFAULT_PATHLOSS_PL0      = 40.0     # dB at d0, free space at 2.4GHz
+DEFAULT_PATHLOSS_EXPONENT = 3.0      # indoor, with obstacles
+DEFAULT_SHADOWING_SIGMA   = 4.0      # dB, the same both ways of a link
+DEFAULT_ASYMMETRY_SIGMA   = 1.0      # dB, drawn for each direction of a link
+DEFAULT_RICIAN_K          = 4.0      # power of the line of sight over the scattered power
+DEFAULT_NOISE_FLOOR       = -100.0   # dBm
+DEFAULT_SENSITIVITY       = -95.0    # dBm, CC2420
+DEFAULT_CAPTURE_THRESHOLD = 3.0      # dB of SINR
+
+# IEEE802.15.4 channels at 2.4GHz
+MIN_CHANNEL               = 11
+NUM_CHANNELS              = 16
+
+# TX power of the power levels of radio_setTxPower(), by level>>2, in dBm; the
+# levels are the PA_LEVEL of the CC2420
+TXPOWER_DBM               = [-25.0,-15.0,-10.0,-7.0,-5.0,-3.0,-1.0,0.0]
+TXPOWER_MAX               = 31
+
+#============================ helpers =========================================
+
+def txPowerToDbm(level):
+    '''
+    TX power, in dBm, of a power level passed to radio_setTxPower().
+    '''
+    return TXPOWER_DBM[min(level,TXPOWER_MAX)>>2]
+
+def mwToDbm(mw):
+    return 10.0*np.log10(mw)
+
+def dbmToMw(dbm):
+    return 10.0**(dbm/10.0)
+
+#============================ classes =========================================
+
+class RadioMedium(object):
+    '''
+    Link budget of the frames sent in a slot.
+
+    Motes are identified by their index in positions. Channels are the
+    IEEE802.15.4 channels, 11 to 26, as passed to radio_setFrequency().
+    '''
+
+    def __init__(self,positions,
+            pathLossD0       = DEFAULT_PATHLOSS_D0,
+            pathLossPl0      = DEFAULT_PATHLOSS_PL0,
+            pathLossExponent = DEFAULT_PATHLOSS_EXPONENT,
+            shadowingSigma   = DEFAULT_SHADOWING_SIGMA,
+            asymmetrySigma   = DEFAULT_ASYMMETRY_SIGMA,
+            fading           = FADING_RAYLEIGH,
+            ricianK          = DEFAULT_RICIAN_K,
+            noiseFloor       = DEFAULT_NOISE_FLOOR,
+            sensitivity      = DEFAULT_SENSITIVITY,
+            captureThreshold = DEFAULT_CAPTURE_THRESHOLD,
+            seed             = None,
+        ):
+        assert fading in (FADING_NONE,FADING_RAYLEIGH,FADING_RICIAN)
+
+        self.positions        = np.atleast_2d(np.asarray(positions,dtype=float))
+        self.pathLossD0       = pathLossD0
+        self.pathLossPl0      = pathLossPl0
+        self.pathLossExponent = pathLossExponent
+        self.fading           = fading
+        self.ricianK          = ricianK
+        self.noiseMw          = dbmToMw(noiseFloor)
+        self.sensitivity      = sensitivity
+        self.captureThreshold = captureThreshold
+        self.rng              = np.random.RandomState(seed)
+
+        numMotes              = len(self.positions)
+
+        # mean gain of each link, [receiver,transmitter], in dB; shadowing is
+        # drawn once, the links keep their quality over the simulation
+        shadowing             = self.rng.normal(0.0,shadowingSigma,(numMotes,numMotes))
+        shadowing             = np.triu(shadowing,1)
+        shadowing             = shadowing+shadowing.T
+        asymmetry             = self.rng.normal(0.0,asymmetrySigma,(numMotes,numMotes))
+        self.gain             = -self._pathLoss(self.positions,self.positions)-shadowing+asymmetry
+        np.fill_diagonal(self.gain,-np.inf)
+
+        # interferers, added with addInterferer()
+        self.interfererPowers = np.zeros(0)
+        self.interfererDuty   = np.zeros(0)
+        self.interfererOnCh   = np.zeros((0,NUM_CHANNELS),dtype=bool)
+        self.interfererGain   = np.zeros((numMotes,0))
+
+    #======================== public ==========================================
+
+    def addInterferer(self,position,txPower,channels,dutyCycle=1.0):
+        '''
+        Add a source of interference, e.g. a WiFi access point.
+
+        \param position  Where it is.
+        \param txPower   Its power, in dBm, on each of its channels.
+        \param channels  The IEEE802.15.4 channels it covers.
+        \param dutyCycle Fraction of the slots it is active in, drawn each slot.
+        '''
+        onCh                  = np.zeros((1,NUM_CHANNELS),dtype=bool)
+        onCh[0,np.asarray(list(channels))-MIN_CHANNEL] = True
+        gain                  = -self._pathLoss(self.positions,np.atleast_2d(np.asarray(position,dtype=float)))
+
+        self.interfererPowers = np.append(self.interfererPowers,txPower)
+        self.interfererDuty   = np.append(self.interfererDuty,dutyCycle)
+        self.interfererOnCh   = np.vstack([self.interfererOnCh,onCh])
+        self.interfererGain   = np.hstack([self.interfererGain,gain])
+
+    def meanRssi(self,src,dst,txPower):
+        '''
+        RSSI, in dBm, of the frames from src at dst before fading, e.g. to draw
+        the topology or pick the positions.
+        '''
+        return txPower+self.gain[dst,src]
+
+    def resolveSlot(self,transmissions,listeners):
+        '''
+        Which frame each listener receives in a slot.
+
+        \param transmissions List of (mote, channel, txPower), the power in
+            dBm, see txPowerToDbm().
+        \param listeners     List of (mote, channel).
+
+        \returns A list with, for each listener, None or the (mote, rssi) of
+            the frame it received.
+        '''
+        if not listeners:
+            return []
+        if not transmissions:
+            return [None]*len(listeners)
+
+        (txMotes,txChs,txPowers) = [np.asarray(v) for v in zip(*transmissions)]
+        (rxMotes,rxChs)          = [np.asarray(v) for v in zip(*listeners)]
+        numRx                    = len(rxMotes)
+
+        # power of each frame at each listener, [listener,transmitter], in mW;
+        # nothing from the other channels
+        rxDbm                    = txPowers[np.newaxis,:]+self.gain[np.ix_(rxMotes,txMotes)]
+        rxDbm                   += self._fadingDb(rxDbm.shape)
+        rxMw                     = np.where(
+            rxChs[:,np.newaxis]==txChs[np.newaxis,:],
+            dbmToMw(rxDbm),
+            0.0,
+        )
+
+        # the listener locks on the strongest frame
+        best                     = np.argmax(rxMw,axis=1)
+        bestMw                   = rxMw[np.arange(numRx),best]
+        interferenceMw           = rxMw.sum(axis=1)-bestMw+self.noiseMw+self._interfererMw(rxMotes,rxChs)
+
+        with np.errstate(divide='ignore'):
+            bestDbm              = mwToDbm(bestMw)
+            sinr                 = mwToDbm(bestMw/interferenceMw)
+        received                 = (bestDbm>=self.sensitivity) & (sinr>=self.captureThreshold)
+
+        returnVal                = [None]*numRx
+        for i in np.flatnonzero(received):
+            returnVal[i]         = (int(txMotes[best[i]]),float(bestDbm[i]))
+        return returnVal
+
+    #======================== private =========================================
+
+    def _pathLoss(self,rxPositions,txPositions):
+        '''
+        Log-distance path loss, in dB, [receiver,transmitter]; no less than at
+        d0, for motes closer than that.
+        '''
+        distance = np.sqrt(((rxPositions[:,np.newaxis,:]-txPositions[np.newaxis,:,:])**2).sum(axis=2))
+        distance = np.maximum(distance,self.pathLossD0)
+        return self.pathLossPl0+10.0*self.pathLossExponent*np.log10(distance/self.pathLossD0)
+
+    def _fadingDb(self,shape):
+        '''
+        Power gain of the fading of each frame, in dB, of mean 1.
+        '''
+        if   self.fading==FADING_NONE:
+            return np.zeros(shape)
+        elif self.fading==FADING_RAYLEIGH:
+            gain = self.rng.exponential(1.0,shape)
+        else:
+            los  = np.sqrt(self.ricianK/(self.ricianK+1.0))
+            sd   = np.sqrt(1.0/(2.0*(self.ricianK+1.0)))
+            gain = (los+sd*self.rng.standard_normal(shape))**2+(sd*self.rng.standard_normal(shape))**2
+        return mwToDbm(np.maximum(gain,1e-12))
+
+    def _interfererMw(self,rxMotes,rxChs):
+        '''
+        Power of the interferers active in this slot at each listener, in mW.
+        '''
+        if len(self.interfererPowers)==0:
+            return np.zeros(len(rxMotes))
+        active   = self.rng.random_sample(len(self.interfererPowers))<self.interfererDuty
+        # [listener,interferer]
+        onCh     = self.interfererOnCh[:,rxChs-MIN_CHANNEL].T & active[np.newaxis,:]
+        powerMw  = dbmToMw(self.interfererPowers[np.newaxis,:]+self.interfererGain[rxMotes,:])
+        return np.where(onCh,powerMw,0.0).sum(axis=1)
+
+#============================ main ============================================
+
+def main():
+    '''
+    Time resolveSlot() on a random deployment, every mote transmitting or
+    listening on a random channel, and print the mean degree.
+    '''
+    parser = argparse.ArgumentParser(description='Time the radio medium on a random deployment.')
+    parser.add_argument('--motes', type=int,   default=300,   help='number of motes')
+    parser.add_argument('--side',  type=float, default=100.0, help='side of the square area, in m')
+    parser.add_argument('--slots', type=int,   default=1000,  help='number of slots')
+    parser.add_argument('--txProbability', type=float, default=0.2, help='probability a mote transmits in a slot')
+    parser.add_argument('--seed',  type=int,   default=0)
+    args   = parser.parse_args()
+
+    rng       = np.random.RandomState(args.seed)
+    positions = rng.uniform(0.0,args.side,(args.motes,2))
+    medium    = RadioMedium(positions,seed=args.seed)
+    medium.addInterferer((args.side/2.0,args.side/2.0),0.0,range(11,15),dutyCycle=0.3)
+    txPower   = txPowerToDbm(TXPOWER_MAX)
+
+    numReceived = 0
+    start       = time.time()
+    for _ in range(args.slots):
+        isTx          = rng.random_sample(args.motes)<args.txProbability
+        channels      = rng.randint(MIN_CHANNEL,MIN_CHANNEL+NUM_CHANNELS,args.motes)
+        transmissions = [(m,channels[m],txPower) for m in np.flatnonzero(isTx)]
+        listeners     = [(m,channels[m])         for m in np.flatnonzero(~isTx)]
+        numReceived  += sum(r is not None for r in medium.resolveSlot(transmissions,listeners))
+    duration    = time.time()-start
+
+    degree      = (medium.gain+txPower>=medium.sensitivity).sum(axis=1).mean()
+    print('{0} motes, mean degree {1:.1f}'.format(args.motes,degree))
+    print('{0} slots in {1:.2f}s, {2:.2f}ms per slot, {3} frames received'.format(
+        args.slots,duration,1000.0*duration/args.slots,numReceived,
+    ))
+
+if __name__=='__main__':
+    main()